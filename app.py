@@ -166,14 +166,14 @@ class OptimizationApp:
                 str(k),
                 str(int(min_distance)),
                 exclude_str,
-                str(int(max_slope))
+                str(int(max_slope)),
+                "--output", "json"
             ]
             
-            # Fallback to old filename if new one doesn't exist
-            if not os.path.exists(os.path.join(self.data_dir, "resource_points.csv")):
-                cmd[1] = "resource_points (1).csv"
-                cmd[2] = "zone_features.csv"
-                cmd[3] = "road_network.csv"
+            # Fallback to the old file names in the working directory
+            legacy_files = ["resource_points (1).csv", "zone_features.csv", "road_network.csv"]
+            if not os.path.exists(cmd[1]) and all(os.path.exists(f) for f in legacy_files):
+                cmd[1:4] = legacy_files
             
             result = subprocess.run(cmd, capture_output=True, text=True, cwd=".")
             
@@ -181,12 +181,29 @@ class OptimizationApp:
                 st.error(f"Optimizer failed: {result.stderr}")
                 return None, None, None
                 
-            return self.parse_cpp_output(result.stdout)
+            return self.parse_cpp_json(result.stdout)
             
         except Exception as e:
             st.error(f"Error running optimizer: {str(e)}")
             return None, None, None
     
+    def parse_cpp_json(self, output: str):
+        """Parse C++ optimizer output written with --output json"""
+        try:
+            data = json.loads(output)
+        except json.JSONDecodeError:
+            # Builds from before --output ignore the flag and print text
+            return self.parse_cpp_output(output)
+        centers = [
+            {key: center[key] for key in ('id', 'lat', 'lon', 'land_type', 'slope', 'elevation')}
+            for center in data['centers']
+        ]
+        assignments = [
+            {'resource_id': resource_id, 'center_id': center_id}
+            for resource_id, center_id in zip(data['point_ids'], data['assignments'])
+        ]
+        return centers, assignments, data['total_cost']
+    
     def parse_cpp_output(self, output: str):
         """Parse C++ optimizer output"""
         lines = output.strip().split('\n')
@@ -7,10 +7,46 @@
 #include <unordered_map>
 #include <set>
 #include <algorithm>
+#include <numeric>
 #include <cmath>
 #include <limits>
 #include <random>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <string_view>
+#include <charconv>
+#include <stdexcept>
+#include <queue>
+#include <deque>
+#include <list>
+#include <tuple>
+#include <memory>
+#include <future>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 struct Point
 {
@@ -24,439 +60,7173 @@ struct Point
     Point() : id(0), lat(0), lon(0), resource_quantity(0), slope(0), elevation(0) {}
 };
 
-class KMedoidsOptimizer
+// Fixed set of worker threads for data-parallel loops. The calling thread
+// takes part as worker 0, so a pool of size 1 runs everything inline.
+class ThreadPool
 {
 private:
-    std::vector<Point> points;
-    std::unordered_map<std::string, std::unordered_map<std::string, double>> distance_matrix;
-    std::vector<int> valid_candidates;
-    int k;
-    double min_distance_km;
-    std::set<std::string> exclude_land_types;
-    double max_slope;
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cv_start, cv_done;
+    // The job is called through a plain function pointer rather than a
+    // std::function, so dispatching a loop does not allocate
+    const void *job = nullptr;
+    void (*job_call)(const void *job, size_t index, int worker) = nullptr;
+    size_t job_count = 0;
+    std::atomic<size_t> next_index{0};
+    int active = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
 
-    std::mt19937 rng;
+    void run_job(int worker)
+    {
+        size_t i;
+        while ((i = next_index.fetch_add(1)) < job_count)
+        {
+            job_call(job, i, worker);
+        }
+    }
+
+    void worker_loop(int worker)
+    {
+        unsigned long seen = 0;
+        while (true)
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv_start.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            lock.unlock();
+
+            run_job(worker);
+
+            lock.lock();
+            if (--active == 0)
+                cv_done.notify_one();
+        }
+    }
 
 public:
-    KMedoidsOptimizer(int k_val, double min_dist, const std::set<std::string> &exclude_types, double max_slope_val)
-        : k(k_val), min_distance_km(min_dist), exclude_land_types(exclude_types), max_slope(max_slope_val)
+    explicit ThreadPool(int num_threads)
     {
-        rng.seed(std::chrono::steady_clock::now().time_since_epoch().count());
+        for (int t = 1; t < num_threads; t++)
+        {
+            workers.emplace_back(&ThreadPool::worker_loop, this, t);
+        }
     }
 
-    void load_points(const std::string &filename)
+    ~ThreadPool()
     {
-        std::ifstream file(filename);
-        if (!file.is_open())
         {
-            std::cerr << "Error: Cannot open " << filename << std::endl;
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv_start.notify_all();
+        for (auto &w : workers)
+            w.join();
+    }
+
+    int size() const { return workers.size() + 1; }
+
+    // Calls fn(index, worker) for every index in [0, count), worker < size()
+    template <typename Fn>
+    void parallel_for(size_t count, const Fn &fn)
+    {
+        if (workers.empty() || count <= 1)
+        {
+            for (size_t i = 0; i < count; i++)
+                fn(i, 0);
             return;
         }
 
-        std::string line;
-        std::getline(file, line); // Skip header
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job = &fn;
+            job_call = [](const void *f, size_t i, int worker) { (*static_cast<const Fn *>(f))(i, worker); };
+            job_count = count;
+            next_index = 0;
+            active = workers.size();
+            generation++;
+        }
+        cv_start.notify_all();
+        run_job(0);
+
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_done.wait(lock, [&] { return active == 0; });
+        job = nullptr;
+    }
+};
+
+// Scratch space for materializing one distance row
+struct RowBuffer
+{
+    std::vector<double> values;
+    std::vector<int> missing;
+    std::vector<double> patch;
+    std::shared_ptr<const void> pinned; // Keeps a staged row alive
+};
+
+// Per-point nearest and second-nearest medoid distances for one medoid set.
+// Lets a swap be scored in O(N) instead of recomputing the total cost.
+struct NearestCache
+{
+    std::vector<int> medoids;
+    std::vector<int> nearest; // Slot in medoids of the nearest medoid
+    std::vector<double> d_nearest;
+    std::vector<double> d_second;
+    double total_cost = 0.0;
+};
+
+// Nearest-medoid kernels over one distance row: best[i] = min(best[i], row[i]),
+// optionally recording slot j where row j is strictly closer, and the
+// quantity-weighted sum of the result. The widest instruction set the CPU
+// supports is picked at startup; float rows are widened to double, and
+// sums always accumulate in double.
+struct CostKernels
+{
+    const char *name;
+    void (*min_f64)(double *best, const double *row, size_t n);
+    void (*min_f32)(double *best, const float *row, size_t n);
+    void (*argmin_f64)(double *best, int *slot, const double *row, int j, size_t n);
+    void (*argmin_f32)(double *best, int *slot, const float *row, int j, size_t n);
+    double (*weighted_sum)(const double *values, const double *weights, size_t n);
+};
+
+template <typename T>
+void min_scalar(double *best, const T *row, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        best[i] = std::min(best[i], static_cast<double>(row[i]));
+}
 
-        while (std::getline(file, line))
+template <typename T>
+void argmin_scalar(double *best, int *slot, const T *row, int j, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (row[i] < best[i])
         {
-            std::istringstream ss(line);
-            std::string token;
-            Point p;
+            best[i] = row[i];
+            slot[i] = j;
+        }
+    }
+}
 
-            // Parse CSV: id,latitude,longitude,resource_quantity
-            if (std::getline(ss, token, ','))
-                p.id = std::stoi(token);
-            if (std::getline(ss, token, ','))
-                p.lat = std::stod(token);
-            if (std::getline(ss, token, ','))
-                p.lon = std::stod(token);
-            if (std::getline(ss, token, ','))
-                p.resource_quantity = std::stod(token);
+double weighted_sum_scalar(const double *values, const double *weights, size_t n)
+{
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++)
+        total += values[i] * weights[i];
+    return total;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) inline __m256d load4_avx2(const double *p) { return _mm256_loadu_pd(p); }
+__attribute__((target("avx2"))) inline __m256d load4_avx2(const float *p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+
+template <typename T>
+__attribute__((target("avx2"))) void min_avx2(double *best, const T *row, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256d b = _mm256_loadu_pd(best + i);
+        const __m256d r = load4_avx2(row + i);
+        _mm256_storeu_pd(best + i, _mm256_blendv_pd(b, r, _mm256_cmp_pd(r, b, _CMP_LT_OQ)));
+    }
+    min_scalar(best + i, row + i, n - i);
+}
+
+template <typename T>
+__attribute__((target("avx2"))) void argmin_avx2(double *best, int *slot, const T *row, int j, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256d b = _mm256_loadu_pd(best + i);
+        const __m256d r = load4_avx2(row + i);
+        const __m256d closer = _mm256_cmp_pd(r, b, _CMP_LT_OQ);
+        int mask = _mm256_movemask_pd(closer);
+        if (!mask)
+            continue;
+        _mm256_storeu_pd(best + i, _mm256_blendv_pd(b, r, closer));
+        for (; mask; mask &= mask - 1)
+            slot[i + __builtin_ctz(mask)] = j;
+    }
+    argmin_scalar(best + i, slot + i, row + i, j, n - i);
+}
+
+__attribute__((target("avx2"))) double weighted_sum_avx2(const double *values, const double *weights, size_t n)
+{
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(values + i), _mm256_loadu_pd(weights + i)));
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, acc);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + weighted_sum_scalar(values + i, weights + i, n - i);
+}
+
+__attribute__((target("avx512f"))) inline __m512d load8_avx512(const double *p) { return _mm512_loadu_pd(p); }
+// The maskz form sidesteps a GCC 12 -Wuninitialized false positive in
+// the plain _mm512_cvtps_pd
+__attribute__((target("avx512f"))) inline __m512d load8_avx512(const float *p)
+{
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(p));
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) void min_avx512(double *best, const T *row, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m512d b = _mm512_loadu_pd(best + i);
+        const __m512d r = load8_avx512(row + i);
+        _mm512_storeu_pd(best + i, _mm512_mask_blend_pd(_mm512_cmp_pd_mask(r, b, _CMP_LT_OQ), b, r));
+    }
+    min_scalar(best + i, row + i, n - i);
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) void argmin_avx512(double *best, int *slot, const T *row, int j, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m512d b = _mm512_loadu_pd(best + i);
+        const __m512d r = load8_avx512(row + i);
+        unsigned mask = _mm512_cmp_pd_mask(r, b, _CMP_LT_OQ);
+        if (!mask)
+            continue;
+        _mm512_storeu_pd(best + i, _mm512_mask_blend_pd(mask, b, r));
+        for (; mask; mask &= mask - 1)
+            slot[i + __builtin_ctz(mask)] = j;
+    }
+    argmin_scalar(best + i, slot + i, row + i, j, n - i);
+}
+
+__attribute__((target("avx512f"))) double weighted_sum_avx512(const double *values, const double *weights, size_t n)
+{
+    __m512d acc = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        acc = _mm512_add_pd(acc, _mm512_mul_pd(_mm512_loadu_pd(values + i), _mm512_loadu_pd(weights + i)));
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, acc);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])) +
+           weighted_sum_scalar(values + i, weights + i, n - i);
+}
+#endif
+
+const CostKernels scalar_kernels = {"scalar", min_scalar<double>, min_scalar<float>, argmin_scalar<double>,
+                                    argmin_scalar<float>, weighted_sum_scalar};
+#if defined(__x86_64__) || defined(__i386__)
+const CostKernels avx2_kernels = {"avx2", min_avx2<double>, min_avx2<float>, argmin_avx2<double>,
+                                  argmin_avx2<float>, weighted_sum_avx2};
+const CostKernels avx512_kernels = {"avx512", min_avx512<double>, min_avx512<float>, argmin_avx512<double>,
+                                    argmin_avx512<float>, weighted_sum_avx512};
+#endif
+
+// The kernels in use; defaults to the best the CPU supports
+const CostKernels *&active_kernels()
+{
+    static const CostKernels *kernels = []
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return &avx512_kernels;
+        if (__builtin_cpu_supports("avx2"))
+            return &avx2_kernels;
+#endif
+        return &scalar_kernels;
+    }();
+    return kernels;
+}
+
+// Selects kernels by name (auto, scalar, avx2, avx512); false when the CPU
+// lacks the instruction set
+bool select_kernels(const std::string &name)
+{
+    if (name == "scalar")
+    {
+        active_kernels() = &scalar_kernels;
+        return true;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (name == "avx2" && __builtin_cpu_supports("avx2"))
+    {
+        active_kernels() = &avx2_kernels;
+        return true;
+    }
+    if (name == "avx512" && __builtin_cpu_supports("avx512f"))
+    {
+        active_kernels() = &avx512_kernels;
+        return true;
+    }
+    if (name == "auto")
+    {
+        active_kernels() = __builtin_cpu_supports("avx512f") ? &avx512_kernels
+                           : __builtin_cpu_supports("avx2") ? &avx2_kernels : &scalar_kernels;
+        return true;
+    }
+#else
+    if (name == "auto")
+    {
+        active_kernels() = &scalar_kernels;
+        return true;
+    }
+#endif
+    return false;
+}
+
+// Zero-copy CSV reader shared by the loaders. The file is memory-mapped and
+// each row is split into string_view fields; numbers are parsed in place.
+// Malformed input throws std::runtime_error naming the file and line.
+class CsvReader
+{
+private:
+    std::string filename;
+    const char *begin = nullptr;
+    const char *cursor = nullptr;
+    const char *end = nullptr;
+    void *map_base = nullptr;
+    size_t map_length = 0;
+    size_t line = 0;
+    std::vector<std::string_view> fields;
+
+    static std::string_view trim(std::string_view token)
+    {
+        while (!token.empty() && (token.front() == ' ' || token.front() == '\t'))
+            token.remove_prefix(1);
+        while (!token.empty() && (token.back() == ' ' || token.back() == '\t' || token.back() == '\r'))
+            token.remove_suffix(1);
+        return token;
+    }
+
+public:
+    CsvReader() = default;
+    CsvReader(const CsvReader &) = delete;
+    CsvReader &operator=(const CsvReader &) = delete;
+
+    ~CsvReader()
+    {
+        if (map_base)
+            munmap(map_base, map_length);
+    }
+
+    bool open(const std::string &path)
+    {
+        filename = path;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return false;
+        }
 
-            points.push_back(p);
+        if (st.st_size > 0)
+        {
+            void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base == MAP_FAILED)
+            {
+                close(fd);
+                return false;
+            }
+            madvise(base, st.st_size, MADV_SEQUENTIAL);
+            map_base = base;
+            map_length = st.st_size;
         }
-        file.close();
-        std::cout << "Loaded " << points.size() << " resource points" << std::endl;
+        close(fd);
+
+        begin = cursor = static_cast<const char *>(map_base);
+        end = begin + map_length;
+        return true;
     }
 
-    void load_zone_features(const std::string &filename)
+    // Advances to the next non-empty row; false at end of file
+    bool next_row()
     {
-        std::ifstream file(filename);
-        if (!file.is_open())
+        while (cursor < end)
         {
-            std::cerr << "Error: Cannot open " << filename << std::endl;
-            return;
+            const char *eol = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+            if (!eol)
+                eol = end;
+            std::string_view row(cursor, eol - cursor);
+            cursor = (eol < end) ? eol + 1 : end;
+            line++;
+
+            if (trim(row).empty())
+                continue;
+
+            fields.clear();
+            size_t start = 0;
+            while (true)
+            {
+                size_t comma = row.find(',', start);
+                if (comma == std::string_view::npos)
+                {
+                    fields.push_back(trim(row.substr(start)));
+                    break;
+                }
+                fields.push_back(trim(row.substr(start, comma - start)));
+                start = comma + 1;
+            }
+            return true;
         }
+        return false;
+    }
 
-        std::string line;
-        std::getline(file, line); // Skip header
+    size_t line_number() const { return line; }
+    size_t field_count() const { return fields.size(); }
+    std::string_view field(size_t i) const { return fields[i]; }
+
+    [[noreturn]] void fail(const std::string &message) const
+    {
+        throw std::runtime_error(filename + ":" + std::to_string(line) + ": " + message);
+    }
+
+    // Fails unless the current row has at least count fields
+    void require_fields(size_t count) const
+    {
+        if (fields.size() < count)
+            fail("expected " + std::to_string(count) + " fields, found " + std::to_string(fields.size()));
+    }
+
+    int field_int(size_t i) const
+    {
+        std::string_view token = fields[i];
+        if (!token.empty() && token.front() == '+')
+            token.remove_prefix(1);
+        int value = 0;
+        auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+        if (result.ec != std::errc() || result.ptr != token.data() + token.size())
+            fail("invalid integer '" + std::string(fields[i]) + "' in field " + std::to_string(i + 1));
+        return value;
+    }
+
+    double field_double(size_t i) const
+    {
+        std::string_view token = fields[i];
+        if (!token.empty() && token.front() == '+')
+            token.remove_prefix(1);
+        double value = 0.0;
+        bool ok = !token.empty();
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        if (ok)
+        {
+            auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+            ok = (result.ec == std::errc() && result.ptr == token.data() + token.size());
+        }
+#else
+        // No floating-point from_chars in this standard library
+        char buffer[64];
+        if (ok && token.size() < sizeof(buffer))
+        {
+            std::memcpy(buffer, token.data(), token.size());
+            buffer[token.size()] = '\0';
+            char *parsed_end = nullptr;
+            value = std::strtod(buffer, &parsed_end);
+            ok = (parsed_end == buffer + token.size());
+        }
+        else
+        {
+            ok = false;
+        }
+#endif
+        if (!ok)
+            fail("invalid number '" + std::string(fields[i]) + "' in field " + std::to_string(i + 1));
+        return value;
+    }
+};
+
+// Minimal JSON document model for scenario files
+struct JsonValue
+{
+    enum class Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    bool is_number() const { return type == Type::Number; }
+    bool is_string() const { return type == Type::String; }
+    bool is_array() const { return type == Type::Array; }
+    bool is_object() const { return type == Type::Object; }
+
+    // Member lookup; nullptr when absent or not an object
+    const JsonValue *find(const std::string &key) const
+    {
+        for (const auto &member : object)
+        {
+            if (member.first == key)
+                return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser
+{
+private:
+    std::string_view text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string &message) const
+    {
+        throw std::runtime_error("JSON offset " + std::to_string(pos) + ": " + message);
+    }
+
+    void skip_whitespace()
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+            pos++;
+    }
+
+    void expect(char c)
+    {
+        skip_whitespace();
+        if (pos >= text.size() || text[pos] != c)
+            fail(std::string("expected '") + c + "'");
+        pos++;
+    }
+
+    bool consume(std::string_view word)
+    {
+        if (text.substr(pos, word.size()) != word)
+            return false;
+        pos += word.size();
+        return true;
+    }
+
+    static void append_utf8(std::string &out, unsigned code)
+    {
+        if (code < 0x80)
+        {
+            out += static_cast<char>(code);
+        }
+        else if (code < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    std::string parse_string()
+    {
+        expect('"');
+        std::string out;
+        while (true)
+        {
+            if (pos >= text.size())
+                fail("unterminated string");
+            char c = text[pos++];
+            if (c == '"')
+                return out;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (pos >= text.size())
+                fail("unterminated string");
+            char e = text[pos++];
+            switch (e)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out += e;
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+            {
+                unsigned code = 0;
+                if (pos + 4 > text.size() ||
+                    std::from_chars(text.data() + pos, text.data() + pos + 4, code, 16).ptr != text.data() + pos + 4)
+                    fail("invalid \\u escape");
+                pos += 4;
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                fail("invalid escape");
+            }
+        }
+    }
+
+    JsonValue parse_value()
+    {
+        skip_whitespace();
+        if (pos >= text.size())
+            fail("unexpected end of input");
+
+        JsonValue value;
+        char c = text[pos];
+        if (c == '{')
+        {
+            value.type = JsonValue::Type::Object;
+            pos++;
+            skip_whitespace();
+            if (pos < text.size() && text[pos] == '}')
+            {
+                pos++;
+                return value;
+            }
+            while (true)
+            {
+                std::string key = parse_string();
+                expect(':');
+                value.object.emplace_back(std::move(key), parse_value());
+                skip_whitespace();
+                if (pos < text.size() && text[pos] == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                expect('}');
+                return value;
+            }
+        }
+        if (c == '[')
+        {
+            value.type = JsonValue::Type::Array;
+            pos++;
+            skip_whitespace();
+            if (pos < text.size() && text[pos] == ']')
+            {
+                pos++;
+                return value;
+            }
+            while (true)
+            {
+                value.array.push_back(parse_value());
+                skip_whitespace();
+                if (pos < text.size() && text[pos] == ',')
+                {
+                    pos++;
+                    continue;
+                }
+                expect(']');
+                return value;
+            }
+        }
+        if (c == '"')
+        {
+            value.type = JsonValue::Type::String;
+            value.string = parse_string();
+            return value;
+        }
+        if (consume("true"))
+        {
+            value.type = JsonValue::Type::Bool;
+            value.boolean = true;
+            return value;
+        }
+        if (consume("false"))
+        {
+            value.type = JsonValue::Type::Bool;
+            return value;
+        }
+        if (consume("null"))
+            return value;
+
+        // Number: strtod over a bounded copy of the token
+        size_t start = pos;
+        while (pos < text.size() && (std::isdigit(static_cast<unsigned char>(text[pos])) || std::strchr("+-.eE", text[pos])))
+            pos++;
+        std::string token(text.substr(start, pos - start));
+        char *parsed_end = nullptr;
+        value.number = std::strtod(token.c_str(), &parsed_end);
+        if (token.empty() || parsed_end != token.c_str() + token.size())
+        {
+            pos = start;
+            fail("invalid value");
+        }
+        value.type = JsonValue::Type::Number;
+        return value;
+    }
+
+public:
+    explicit JsonParser(std::string_view input) : text(input) {}
+
+    JsonValue parse()
+    {
+        JsonValue value = parse_value();
+        skip_whitespace();
+        if (pos != text.size())
+            fail("trailing characters");
+        return value;
+    }
+};
+
+// Quoted, escaped JSON string literal
+std::string json_quote(const std::string &s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                out += buffer;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+// On-disk layout of a binary distance matrix (native byte order):
+//   BinaryMatrixHeader
+//   int32 ids[n]          point ID of each row and column
+//   uint8 row_flags[n]    1 when the row has no missing (NaN) entries
+//   padding up to data_offset (64-byte aligned)
+//   value data[n * n]     row r holds the distances from every point to point r
+struct BinaryMatrixHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint64_t n;
+    double scale; // Meters per stored unit
+    uint64_t data_offset;
+};
+
+static const char binary_matrix_magic[8] = {'C', 'O', 'D', 'M', 'A', 'T', 'R', 'X'};
+
+// Layout of --output binary results (native byte order):
+//   BinaryResultHeader
+//   int32 center_ids[k]
+//   float64 center_loads[k]   resource quantity assigned to each center
+//   int32 point_ids[n]
+//   int32 assignments[n]      index into center_ids of each point's center
+// Capacitated runs write version 2, where total_cost excludes the overflow
+// penalty, center_loads come from the flow, assignments name the center
+// taking the largest share, and the point shares follow:
+//   float64 unserved          quantity no center could take
+//   uint64 num_shares
+//   BinaryResultShare shares[num_shares], ordered by point
+struct BinaryResultHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t k;
+    uint64_t n;
+    double total_cost;
+};
+
+struct BinaryResultShare
+{
+    int32_t point;   // Index into point_ids
+    int32_t center;  // Index into center_ids
+    double quantity;
+};
+
+static const char binary_result_magic[8] = {'C', 'O', 'D', 'R', 'E', 'S', 'L', 'T'};
+
+// Dense N x N distance storage in meters, either owned or memory-mapped from
+// a binary matrix file. Row r holds the distances from every point to point r,
+// so the row of a medoid is contiguous. Missing pairs are NaN. U16 stores
+// rounded multiples of scale meters with u16_missing for missing pairs.
+class DistanceMatrix
+{
+public:
+    enum DType : uint32_t
+    {
+        F64 = 0,
+        F32 = 1,
+        U16 = 2
+    };
+
+    static constexpr uint16_t u16_missing = 0xFFFF;
+
+    static size_t value_size(DType type)
+    {
+        return type == F64 ? sizeof(double) : type == F32 ? sizeof(float) : sizeof(uint16_t);
+    }
+
+    // Rounds meters to units of unit meters; false if out of the u16 range
+    static bool encode_u16(double meters, double unit, uint16_t &out)
+    {
+        if (std::isnan(meters))
+        {
+            out = u16_missing;
+            return true;
+        }
+        const double units = std::round(meters / unit);
+        if (!(units >= 0 && units < u16_missing))
+            return false;
+        out = static_cast<uint16_t>(units);
+        return true;
+    }
+
+private:
+    size_t n = 0;
+    DType dtype = F64;
+    double scale = 1.0; // Meters per stored unit
+    const void *data = nullptr;
+    std::vector<double> owned_f64;
+    std::vector<float> owned_f32;
+    std::vector<uint16_t> owned_u16;
+    std::vector<char> complete;
+    void *map_base = nullptr;
+    size_t map_length = 0;
+
+    void unmap()
+    {
+        if (map_base)
+        {
+            munmap(map_base, map_length);
+            map_base = nullptr;
+            map_length = 0;
+        }
+    }
+
+public:
+    DistanceMatrix() = default;
+    DistanceMatrix(const DistanceMatrix &) = delete;
+    DistanceMatrix &operator=(const DistanceMatrix &) = delete;
+    ~DistanceMatrix() { unmap(); }
+
+    bool empty() const { return n == 0; }
+    size_t size() const { return n; }
+    DType type() const { return dtype; }
+    double unit() const { return scale; }
+    bool mapped() const { return map_base != nullptr; }
+    size_t row_bytes() const { return n * value_size(dtype); }
+    bool row_complete(size_t r) const { return complete[r]; }
+    const char *raw_row(size_t r) const { return static_cast<const char *>(data) + r * row_bytes(); }
+
+    // Drops the mapped pages of row r from memory; they are re-read on access
+    void release_row(size_t r) const
+    {
+        if (!map_base)
+            return;
+        const uintptr_t page = sysconf(_SC_PAGESIZE);
+        const uintptr_t begin = (reinterpret_cast<uintptr_t>(raw_row(r)) + page - 1) / page * page;
+        const uintptr_t end = (reinterpret_cast<uintptr_t>(raw_row(r)) + row_bytes()) / page * page;
+        if (end > begin)
+            madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+    }
+
+    void reset()
+    {
+        unmap();
+        n = 0;
+        dtype = F64;
+        scale = 1.0;
+        data = nullptr;
+        owned_f64 = std::vector<double>();
+        owned_f32 = std::vector<float>();
+        owned_u16 = std::vector<uint16_t>();
+        complete.clear();
+    }
+
+    // Owned count x count matrix of missing entries, filled with set().
+    // Call finalize_rows() once it is filled.
+    void allocate(size_t count, DType type, double unit = 1.0)
+    {
+        reset();
+        n = count;
+        dtype = type;
+        scale = (type == U16) ? unit : 1.0;
+        if (type == U16)
+        {
+            owned_u16.assign(n * n, u16_missing);
+            data = owned_u16.data();
+        }
+        else if (type == F32)
+        {
+            owned_f32.assign(n * n, std::numeric_limits<float>::quiet_NaN());
+            data = owned_f32.data();
+        }
+        else
+        {
+            owned_f64.assign(n * n, std::numeric_limits<double>::quiet_NaN());
+            data = owned_f64.data();
+        }
+    }
+
+    // Stores d(from, to) in an owned matrix; false when a U16 value is out of range
+    bool set(size_t from, size_t to, double meters)
+    {
+        const size_t at = to * n + from;
+        if (dtype == F64)
+            owned_f64[at] = meters;
+        else if (dtype == F32)
+            owned_f32[at] = static_cast<float>(meters);
+        else
+            return encode_u16(meters, scale, owned_u16[at]);
+        return true;
+    }
+
+    // Reads a caller-owned count x count matrix in place; the caller keeps
+    // it alive and unchanged while this matrix is in use
+    void borrow(const void *values, size_t count, DType type)
+    {
+        reset();
+        n = count;
+        dtype = type;
+        data = values;
+        finalize_rows();
+    }
+
+    void finalize_rows()
+    {
+        complete.assign(n, 1);
+        for (size_t r = 0; r < n; r++)
+        {
+            for (size_t c = 0; c < n; c++)
+            {
+                if (std::isnan(at(c, r)))
+                {
+                    complete[r] = 0;
+                    break;
+                }
+            }
+        }
+    }
+
+    const double *row_f64(size_t r) const { return static_cast<const double *>(data) + r * n; }
+    const float *row_f32(size_t r) const { return static_cast<const float *>(data) + r * n; }
+    const uint16_t *row_u16(size_t r) const { return static_cast<const uint16_t *>(data) + r * n; }
+
+    double decode(uint16_t units) const
+    {
+        return units == u16_missing ? std::numeric_limits<double>::quiet_NaN() : units * scale;
+    }
+
+    double at(size_t from, size_t to) const
+    {
+        if (dtype == F32)
+            return row_f32(to)[from];
+        if (dtype == U16)
+            return decode(row_u16(to)[from]);
+        return row_f64(to)[from];
+    }
+
+    // Maps a binary matrix file read-only; ids receives its point ID table
+    bool map_binary(const std::string &filename, std::vector<int> &ids)
+    {
+        reset();
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            std::cerr << "Error: Cannot open " << filename << std::endl;
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BinaryMatrixHeader))
+        {
+            std::cerr << "Error: " << filename << " is too small for a distance matrix" << std::endl;
+            close(fd);
+            return false;
+        }
+
+        void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+        {
+            std::cerr << "Error: Cannot map " << filename << std::endl;
+            return false;
+        }
+        map_base = base;
+        map_length = st.st_size;
+
+        const char *bytes = static_cast<const char *>(base);
+        BinaryMatrixHeader header;
+        std::memcpy(&header, bytes, sizeof(header));
+        const bool known_type = header.dtype == F64 || header.dtype == F32 ||
+                                (header.dtype == U16 && header.scale > 0 && std::isfinite(header.scale));
+        if (std::memcmp(header.magic, binary_matrix_magic, sizeof(header.magic)) != 0 || header.version != 1 || !known_type)
+        {
+            std::cerr << "Error: " << filename << " is not a valid binary distance matrix" << std::endl;
+            unmap();
+            return false;
+        }
+
+        // Every size is checked against the file length by division, so a
+        // corrupt header cannot overflow into an in-range value
+        const uint64_t length = map_length;
+        const uint64_t value_bytes = value_size(static_cast<DType>(header.dtype));
+        const uint64_t table_bytes = sizeof(int32_t) + 1; // ID and completeness flag per point
+        const char *problem = nullptr;
+        if (header.n > (length - sizeof(header)) / table_bytes)
+            problem = "point tables extend past the end of the file";
+        else if (header.data_offset < sizeof(header) + header.n * table_bytes || header.data_offset > length)
+            problem = "data offset is outside the file or overlaps the point tables";
+        else if (header.data_offset % value_bytes != 0)
+            problem = "data offset is not aligned to the value size";
+        else if (header.n > 0 && header.n > (length - header.data_offset) / value_bytes / header.n)
+            problem = "matrix data is truncated";
+        if (problem)
+        {
+            std::cerr << "Error: " << filename << ": " << problem << " (" << header.n << " points, "
+                      << length << " bytes)" << std::endl;
+            unmap();
+            return false;
+        }
+
+        n = header.n;
+        dtype = static_cast<DType>(header.dtype);
+        scale = (dtype == U16) ? header.scale : 1.0;
+        data = bytes + header.data_offset;
+
+        ids.resize(n);
+        std::memcpy(ids.data(), bytes + sizeof(header), n * sizeof(int32_t));
+        const char *flags = bytes + sizeof(header) + n * sizeof(int32_t);
+        complete.assign(flags, flags + n);
+        return true;
+    }
+
+    // Writes the matrix in the binary format with the given storage type;
+    // false if a U16 value does not fit at that unit
+    bool write_binary(const std::string &filename, const std::vector<int> &ids, DType type, double unit) const
+    {
+        if (type != U16)
+            unit = 1.0;
+        if (type == U16 && !(unit > 0))
+        {
+            std::cerr << "Error: Invalid u16 unit " << unit << std::endl;
+            return false;
+        }
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Error: Cannot open " << filename << std::endl;
+            return false;
+        }
+
+        BinaryMatrixHeader header;
+        std::memcpy(header.magic, binary_matrix_magic, sizeof(header.magic));
+        header.version = 1;
+        header.dtype = type;
+        header.n = n;
+        header.scale = unit;
+        header.data_offset = (sizeof(header) + n * (sizeof(int32_t) + 1) + 63) / 64 * 64;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        std::vector<int32_t> id_table(ids.begin(), ids.end());
+        file.write(reinterpret_cast<const char *>(id_table.data()), n * sizeof(int32_t));
+        file.write(complete.data(), n);
+        std::vector<char> padding(header.data_offset - sizeof(header) - n * (sizeof(int32_t) + 1), 0);
+        file.write(padding.data(), padding.size());
+
+        std::vector<double> f64(type == F64 ? n : 0);
+        std::vector<float> f32(type == F32 ? n : 0);
+        std::vector<uint16_t> u16(type == U16 ? n : 0);
+        for (size_t r = 0; r < n; r++)
+        {
+            const char *bytes = nullptr;
+            for (size_t c = 0; c < n; c++)
+            {
+                const double meters = at(c, r);
+                if (type == F64)
+                    f64[c] = meters;
+                else if (type == F32)
+                    f32[c] = static_cast<float>(meters);
+                else if (!encode_u16(meters, unit, u16[c]))
+                {
+                    std::cerr << "Error: Distance " << meters << " m does not fit u16 units of " << unit << " m" << std::endl;
+                    return false;
+                }
+            }
+            if (type == F64)
+                bytes = reinterpret_cast<const char *>(f64.data());
+            else if (type == F32)
+                bytes = reinterpret_cast<const char *>(f32.data());
+            else
+                bytes = reinterpret_cast<const char *>(u16.data());
+            file.write(bytes, n * value_size(type));
+        }
+        return static_cast<bool>(file);
+    }
+};
+
+// Bounded in-memory staging of the candidate rows of a memory-mapped matrix
+// that does not fit in RAM. Candidate positions are grouped into tiles of
+// consecutive rows, which lie in file order. The swap search announces the
+// candidates it will score next and a loader thread copies their tiles in
+// while the current ones are scored, so a pass reads each tile once. Rows
+// outside a resident tile, such as medoid rows, are staged one at a time.
+// Least recently used entries are dropped to stay within the byte budget.
+// There is no separate tiled file layout: each row is one contiguous run of
+// N values in the row-major binary file, and a tile reads its rows in
+// increasing file order, but non-candidate rows between them are skipped.
+class TileCache
+{
+private:
+    std::shared_ptr<const DistanceMatrix> matrix;
+    std::vector<int> rows; // Matrix row of each candidate position
+    size_t tile_rows = 1;
+    size_t budget = 0; // Bytes
+    size_t used = 0;
+
+    struct Entry
+    {
+        std::shared_ptr<const std::vector<char>> bytes;
+        std::list<size_t>::iterator recent;
+    };
+    std::unordered_map<size_t, Entry> resident; // Tile t, or tiles() + position for single rows
+    std::list<size_t> recent;                   // Keys, most recently used first
+    std::vector<char> pending;                  // By tile: queued or loading
+    std::deque<size_t> queue;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread loader;
+    bool stopping = false;
+
+    size_t tiles() const { return pending.size(); }
+
+    std::shared_ptr<const std::vector<char>> load(size_t first, size_t count) const
+    {
+        const size_t bytes = matrix->row_bytes();
+        auto staged = std::make_shared<std::vector<char>>(count * bytes);
+        for (size_t p = 0; p < count; p++)
+        {
+            std::memcpy(staged->data() + p * bytes, matrix->raw_row(rows[first + p]), bytes);
+            matrix->release_row(rows[first + p]);
+        }
+        return staged;
+    }
+
+    // Caller holds the mutex
+    void insert(size_t key, std::shared_ptr<const std::vector<char>> bytes)
+    {
+        if (resident.count(key))
+            return;
+        recent.push_front(key);
+        used += bytes->size();
+        resident[key] = {std::move(bytes), recent.begin()};
+        while (used > budget && recent.size() > 1)
+        {
+            auto victim = resident.find(recent.back());
+            used -= victim->second.bytes->size();
+            resident.erase(victim);
+            recent.pop_back();
+        }
+    }
+
+    const char *lookup(size_t key, size_t offset, std::shared_ptr<const void> &pin)
+    {
+        auto it = resident.find(key);
+        if (it == resident.end())
+            return nullptr;
+        recent.splice(recent.begin(), recent, it->second.recent);
+        pin = it->second.bytes;
+        return it->second.bytes->data() + offset * matrix->row_bytes();
+    }
+
+    void run_loader()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            changed.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            const size_t tile = queue.front();
+            queue.pop_front();
+            lock.unlock();
+            const size_t first = tile * tile_rows;
+            auto bytes = load(first, std::min(tile_rows, rows.size() - first));
+            lock.lock();
+            insert(tile, std::move(bytes));
+            pending[tile] = 0;
+            changed.notify_all();
+        }
+    }
+
+public:
+    TileCache(std::shared_ptr<const DistanceMatrix> source, std::vector<int> candidate_rows, size_t max_tile_rows, size_t budget_bytes)
+        : matrix(std::move(source)), rows(std::move(candidate_rows)), budget(budget_bytes)
+    {
+        // Room for the tile being scored, the next one and some single rows
+        tile_rows = std::max<size_t>(1, std::min(max_tile_rows, budget / (3 * std::max<size_t>(1, matrix->row_bytes()))));
+        pending.assign((rows.size() + tile_rows - 1) / tile_rows, 0);
+        loader = std::thread(&TileCache::run_loader, this);
+    }
+
+    ~TileCache()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        loader.join();
+    }
+
+    size_t rows_per_tile() const { return tile_rows; }
+    size_t tile_count() const { return tiles(); }
+
+    // Queues the tiles holding these candidate positions, in order
+    void prefetch(const int *positions, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t last = tiles();
+        for (size_t i = 0; i < count; i++)
+        {
+            const size_t tile = positions[i] / tile_rows;
+            if (tile == last)
+                continue;
+            last = tile;
+            std::shared_ptr<const void> pin;
+            if (!pending[tile] && !lookup(tile, 0, pin))
+            {
+                pending[tile] = 1;
+                queue.push_back(tile);
+            }
+        }
+        changed.notify_all();
+    }
+
+    // Stored row of candidate position pos, kept alive by pin. Waits for its
+    // tile when that is being loaded, otherwise stages the row alone.
+    const char *row(size_t pos, std::shared_ptr<const void> &pin)
+    {
+        const size_t tile = pos / tile_rows;
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return !pending[tile]; });
+        if (const char *staged = lookup(tile, pos - tile * tile_rows, pin))
+            return staged;
+        if (const char *staged = lookup(tiles() + pos, 0, pin))
+            return staged;
+        lock.unlock();
+        auto bytes = load(pos, 1);
+        pin = bytes;
+        lock.lock();
+        insert(tiles() + pos, bytes);
+        return bytes->data();
+    }
+};
+
+// Sparse road network in CSR form, built from a From_ID,To_ID,Distance edge
+// list. Edges are treated as two-way road segments with lengths in meters.
+class RoadGraph
+{
+private:
+    std::unordered_map<int, int> node_index;
+    std::vector<int> offsets; // Edges of node v are [offsets[v], offsets[v + 1])
+    std::vector<int> targets;
+    std::vector<double> lengths;
+
+public:
+    bool empty() const { return offsets.empty(); }
+    size_t node_count() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t edge_count() const { return targets.size(); }
+
+    // Node of a point ID, or -1 if no edge touches it
+    int node_of(int id) const
+    {
+        auto it = node_index.find(id);
+        return (it != node_index.end()) ? it->second : -1;
+    }
+
+    void build(const std::vector<std::pair<int, int>> &edges, const std::vector<double> &edge_lengths)
+    {
+        node_index.clear();
+        for (const auto &e : edges)
+        {
+            node_index.emplace(e.first, node_index.size());
+            node_index.emplace(e.second, node_index.size());
+        }
+
+        const size_t nodes = node_index.size();
+        std::vector<int> degree(nodes, 0);
+        for (const auto &e : edges)
+        {
+            degree[node_index[e.first]]++;
+            degree[node_index[e.second]]++;
+        }
+
+        offsets.assign(nodes + 1, 0);
+        for (size_t v = 0; v < nodes; v++)
+            offsets[v + 1] = offsets[v] + degree[v];
+
+        targets.resize(offsets[nodes]);
+        lengths.resize(offsets[nodes]);
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t e = 0; e < edges.size(); e++)
+        {
+            int a = node_index[edges[e].first];
+            int b = node_index[edges[e].second];
+            targets[fill[a]] = b;
+            lengths[fill[a]++] = edge_lengths[e];
+            targets[fill[b]] = a;
+            lengths[fill[b]++] = edge_lengths[e];
+        }
+    }
+
+    // Dijkstra from source; dist receives one entry per node (infinity if unreachable)
+    void shortest_paths(int source, std::vector<double> &dist) const
+    {
+        typedef std::pair<double, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        dist.assign(node_count(), std::numeric_limits<double>::infinity());
+        dist[source] = 0.0;
+        heap.push({0.0, source});
+
+        while (!heap.empty())
+        {
+            auto [d, v] = heap.top();
+            heap.pop();
+            if (d > dist[v])
+                continue;
+            for (int e = offsets[v]; e < offsets[v + 1]; e++)
+            {
+                double nd = d + lengths[e];
+                if (nd < dist[targets[e]])
+                {
+                    dist[targets[e]] = nd;
+                    heap.push({nd, targets[e]});
+                }
+            }
+        }
+    }
+};
+
+// Distances restricted to the candidate centers: a |C| x N block of candidate
+// rows (distances from every point to each candidate) and a |C| x |C| block
+// for the min-distance constraint, both fully resolved with no NaN. A worker
+// of a distributed solve holds only its share's rows and no pairs block.
+struct CandidateBlock
+{
+    std::vector<int> candidates;
+    std::vector<int> position; // Candidate position of each point, or -1
+    std::vector<double> rows;
+    std::vector<double> pairs; // pairs[b * |C| + a] = d(candidate a, candidate b)
+
+    bool empty() const { return candidates.empty(); }
+    const double *row(int pos, size_t n) const { return &rows[static_cast<size_t>(pos) * n]; }
+};
+
+// A (sub)problem for the swap search: the points being served, their
+// weights, the candidate positions allowed as medoids and a row accessor
+// returning distances from those points to a candidate.
+struct SwapProblem
+{
+    size_t n = 0;
+    const double *weights = nullptr;
+    std::vector<int> candidates; // Positions in valid_candidates
+    std::function<const double *(int pos, RowBuffer &buf)> row;
+    std::vector<double> capacities; // By candidate position; empty when uncapacitated
+    bool geo = false;               // Rows are Haversine over the loaded points
+    std::function<void(const int *positions, size_t count)> prefetch; // Optional; rows scored next
+    bool reports = false; // Costs are full-problem costs, so improvements go to the progress callback
+};
+
+// Best swap a distributed worker found among its candidates
+struct SwapProposal
+{
+    int candidate = -1; // Point index; -1 when no swap improves
+    int slot = -1;
+    double delta = 0.0;
+    double cost = 0.0; // Of the medoids the pass was scored for
+};
+
+// Remote side of a distributed solve, see optimize_distributed()
+struct PassScorer
+{
+    std::function<bool(size_t num_candidates)> begin; // Partitions the candidates; false on error
+    std::function<bool(const std::vector<int> &medoids, SwapProposal &best)> score;
+};
+
+// Symmetric bitset adjacency over valid candidates: bit (a, b) is set when
+// candidates a and b are closer than the minimum center distance, so they
+// can never both be medoids.
+struct ConflictGraph
+{
+    std::vector<int> candidates;
+    double min_distance_m = 0.0;
+    size_t words = 0; // 64-bit words per row
+    std::vector<uint64_t> bits;
+
+    bool enabled() const { return !bits.empty(); }
+    const uint64_t *row(int pos) const { return &bits[static_cast<size_t>(pos) * words]; }
+    bool test(int a, int b) const { return (row(a)[b >> 6] >> (b & 63)) & 1; }
+};
+
+// Uniform latitude/longitude grid over a set of points. Each cell keeps its
+// members contiguously with a bounding circle, so by the triangle inequality
+// no member is closer to x than d(x, center) - radius.
+struct SpatialGrid
+{
+    std::vector<int> members;    // Point indices grouped by cell
+    std::vector<int> cell_start; // Cell c holds members[cell_start[c] .. cell_start[c + 1])
+    std::vector<double> center_lat, center_lon, center_cos; // Radians
+    std::vector<double> radius;                             // Meters
+
+    size_t cells() const { return radius.size(); }
+};
+
+// Min-cost assignment of point quantities to k capacitated centers (a
+// transportation problem), solved by successive shortest paths over the k
+// center slots plus an overflow slot k for quantity no center can take.
+// A residual edge a -> b moves part of one point's quantity from slot a to
+// slot b; the cheapest such move for each pair is kept in a lazy heap, so a
+// path search costs O(k^2) instead of touching every point. Quantities may
+// be split between centers. Replacing a center keeps the other flows and
+// only reroutes the quantity it served, which is what the swap search uses.
+class CapacitatedAssignment
+{
+private:
+    struct Arc
+    {
+        int point;
+        int slot;
+        double amount;
+        int next; // Next arc of the same point, or -1
+    };
+
+    size_t n = 0;
+    int k = 0;
+    const double *weights = nullptr;
+    double penalty = 0.0; // Cost per unit in the overflow slot
+    double min_flow = 0.0;
+    double tolerance = 0.0; // Smallest cost change that counts, in meters per unit
+    std::vector<const double *> rows; // Distances from every point to each center
+    std::vector<double> capacity;     // By slot; the overflow slot is unlimited
+    std::vector<double> load;
+    std::vector<Arc> arcs;
+    std::vector<int> head; // First arc of each point, or -1
+    std::vector<std::pair<int, double>> pending; // Point, quantity still to route
+    std::vector<char> fresh;                     // Slots changed since the last solve()
+    std::vector<Arc> spare_arcs;                 // Reused by solve()
+    double total_cost = 0.0;
+
+    // moves[a * (k + 1) + b]: min-heap of (cost change, arc) for arcs in slot a
+    std::vector<std::vector<std::pair<double, int>>> moves;
+    std::vector<double> label;
+    std::vector<int> pred, pred_arc;
+
+    double distance(int point, int slot) const { return slot < k ? rows[slot][point] : penalty; }
+
+    void push_moves(int e)
+    {
+        const Arc &arc = arcs[e];
+        const double here = distance(arc.point, arc.slot);
+        for (int b = 0; b <= k; b++)
+        {
+            if (b == arc.slot)
+                continue;
+            auto &heap = moves[arc.slot * (k + 1) + b];
+            heap.emplace_back(distance(arc.point, b) - here, e);
+            std::push_heap(heap.begin(), heap.end(), std::greater<>());
+        }
+    }
+
+    // Cheapest live move from slot a to slot b, or -1
+    int best_move(int a, int b)
+    {
+        auto &heap = moves[a * (k + 1) + b];
+        while (!heap.empty() && arcs[heap.front().second].amount <= min_flow)
+        {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+            heap.pop_back();
+        }
+        return heap.empty() ? -1 : heap.front().second;
+    }
+
+    void add_flow(int point, int slot, double amount)
+    {
+        int e = head[point];
+        while (e >= 0 && arcs[e].slot != slot)
+            e = arcs[e].next;
+        if (e < 0)
+        {
+            e = arcs.size();
+            arcs.push_back({point, slot, 0.0, head[point]});
+            head[point] = e;
+        }
+        const bool was_live = arcs[e].amount > min_flow;
+        arcs[e].amount += amount;
+        if (!was_live)
+            push_moves(e);
+    }
+
+    // Bellman-Ford over the slots from the initial labels, moving flow
+    // between slots; the residual graph has no negative cycles
+    void shortest_paths()
+    {
+        const int slots = k + 1;
+        std::fill(pred.begin(), pred.end(), -1);
+        bool changed = true;
+        for (int round = 0; changed && round < slots; round++)
+        {
+            changed = false;
+            for (int a = 0; a < slots; a++)
+            {
+                if (label[a] == std::numeric_limits<double>::infinity())
+                    continue;
+                for (int b = 0; b < slots; b++)
+                {
+                    if (a == b)
+                        continue;
+                    const int e = best_move(a, b);
+                    if (e < 0)
+                        continue;
+                    const double through = label[a] + moves[a * slots + b].front().first;
+                    if (through < label[b] - tolerance)
+                    {
+                        label[b] = through;
+                        pred[b] = a;
+                        pred_arc[b] = e;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Moves amount along the path ending at target; returns the first slot
+    int shift(int target, double amount)
+    {
+        int b = target;
+        for (int guard = 0; pred[b] >= 0 && guard <= k; guard++)
+        {
+            arcs[pred_arc[b]].amount -= amount;
+            add_flow(arcs[pred_arc[b]].point, b, amount);
+            b = pred[b];
+        }
+        return b;
+    }
+
+    double bottleneck(int target, double amount) const
+    {
+        for (int b = target, guard = 0; pred[b] >= 0 && guard <= k; b = pred[b], guard++)
+            amount = std::min(amount, arcs[pred_arc[b]].amount);
+        return amount;
+    }
+
+    // Routes quantity from point along shortest residual paths
+    void route(int point, double quantity)
+    {
+        while (quantity > min_flow)
+        {
+            for (int b = 0; b <= k; b++)
+                label[b] = distance(point, b);
+            shortest_paths();
+
+            int target = k; // The overflow slot always has room
+            for (int b = 0; b < k; b++)
+            {
+                if (load[b] < capacity[b] - min_flow && label[b] < label[target])
+                    target = b;
+            }
+
+            const double amount = bottleneck(target, std::min(quantity, capacity[target] - load[target]));
+            add_flow(point, shift(target, amount), amount);
+            load[target] += amount;
+            quantity -= amount;
+        }
+    }
+
+    // A new center's spare capacity can shorten routed paths: moves routed
+    // quantity into the slot while a chain of moves from a loaded slot ends
+    // there at negative cost
+    void fill(int slot)
+    {
+        while (load[slot] < capacity[slot] - min_flow)
+        {
+            for (int b = 0; b <= k; b++)
+                label[b] = (b != slot && load[b] > min_flow) ? 0.0 : std::numeric_limits<double>::infinity();
+            shortest_paths();
+            if (!(label[slot] < -tolerance))
+                break;
+
+            int start = slot;
+            for (int guard = 0; pred[start] >= 0 && guard <= k; guard++)
+                start = pred[start];
+            const double amount = bottleneck(slot, std::min(capacity[slot] - load[slot], load[start]));
+            shift(slot, amount);
+            load[start] -= amount;
+            load[slot] += amount;
+        }
+    }
+
+public:
+    void reset(size_t num_points, const double *point_weights, int num_centers, double overflow_penalty)
+    {
+        n = num_points;
+        k = num_centers;
+        weights = point_weights;
+        penalty = overflow_penalty;
+        double total_weight = 0.0;
+        for (size_t i = 0; i < n; i++)
+            total_weight += std::max(weights[i], 0.0);
+        min_flow = 1e-12 * std::max(total_weight, 1.0);
+        tolerance = 1e-12 * penalty;
+
+        rows.assign(k, nullptr);
+        capacity.assign(k + 1, std::numeric_limits<double>::infinity());
+        load.assign(k + 1, 0.0);
+        arcs.clear();
+        head.assign(n, -1);
+        pending.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            if (weights[i] > 0)
+                pending.emplace_back(i, weights[i]);
+        }
+        fresh.assign(k, 0);
+        total_cost = 0.0;
+        label.resize(k + 1);
+        pred.resize(k + 1);
+        pred_arc.resize(k + 1);
+    }
+
+    // Puts a center in slot; the quantity of the center it replaces is
+    // rerouted by the next solve()
+    void set_center(int slot, const double *row, double center_capacity)
+    {
+        for (Arc &arc : arcs)
+        {
+            if (arc.slot == slot && arc.amount > min_flow)
+            {
+                pending.emplace_back(arc.point, arc.amount);
+                arc.amount = 0.0;
+            }
+        }
+        load[slot] = 0.0;
+        rows[slot] = row;
+        capacity[slot] = center_capacity;
+        fresh[slot] = 1;
+    }
+
+    void solve()
+    {
+        if (pending.empty() && std::find(fresh.begin(), fresh.end(), 1) == fresh.end())
+            return;
+
+        // Drop dead arcs, then index the moves of the live ones
+        std::vector<Arc> &live = spare_arcs;
+        live.clear();
+        std::fill(head.begin(), head.end(), -1);
+        for (const Arc &arc : arcs)
+        {
+            if (arc.amount > min_flow)
+            {
+                live.push_back({arc.point, arc.slot, arc.amount, head[arc.point]});
+                head[arc.point] = live.size() - 1;
+            }
+        }
+        arcs.swap(live);
+        moves.resize((k + 1) * (k + 1));
+        for (auto &heap : moves)
+            heap.clear();
+        for (size_t e = 0; e < arcs.size(); e++)
+            push_moves(e);
+
+        for (int slot = 0; slot < k; slot++)
+        {
+            if (fresh[slot])
+                fill(slot);
+        }
+        std::fill(fresh.begin(), fresh.end(), 0);
+        for (const auto &[point, quantity] : pending)
+            route(point, quantity);
+        pending.clear();
+
+        total_cost = 0.0;
+        for (const Arc &arc : arcs)
+            total_cost += arc.amount * distance(arc.point, arc.slot);
+    }
+
+    // Takes over another solver's flow; the heaps are rebuilt by solve()
+    void copy_flow(const CapacitatedAssignment &other)
+    {
+        n = other.n;
+        k = other.k;
+        weights = other.weights;
+        penalty = other.penalty;
+        min_flow = other.min_flow;
+        tolerance = other.tolerance;
+        rows = other.rows;
+        capacity = other.capacity;
+        load = other.load;
+        arcs = other.arcs;
+        head = other.head;
+        pending = other.pending;
+        fresh = other.fresh;
+        total_cost = other.total_cost;
+        label.resize(k + 1);
+        pred.resize(k + 1);
+        pred_arc.resize(k + 1);
+    }
+
+    double cost() const { return total_cost; }
+    double unserved() const { return load[k]; }
+    double center_load(int slot) const { return load[slot]; }
+
+    // Cost of the quantity the centers take, without the overflow penalty
+    double transport_cost() const
+    {
+        double sum = 0.0;
+        for (const Arc &arc : arcs)
+        {
+            if (arc.slot < k && arc.amount > min_flow)
+                sum += arc.amount * rows[arc.slot][arc.point];
+        }
+        return sum;
+    }
+
+    // (point, slot, quantity) of every center share, ordered by point and slot
+    std::vector<std::tuple<int, int, double>> shares() const
+    {
+        std::vector<std::tuple<int, int, double>> result;
+        for (const Arc &arc : arcs)
+        {
+            if (arc.slot < k && arc.amount > min_flow)
+                result.emplace_back(arc.point, arc.slot, arc.amount);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Slot serving the largest share of each point; points with no quantity
+    // or only overflow go to their nearest center
+    std::vector<int> assignments() const
+    {
+        std::vector<int> slot(n, -1);
+        std::vector<double> share(n, 0.0);
+        for (const Arc &arc : arcs)
+        {
+            if (arc.slot < k && arc.amount > share[arc.point])
+            {
+                share[arc.point] = arc.amount;
+                slot[arc.point] = arc.slot;
+            }
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            if (slot[i] >= 0 || k == 0)
+                continue;
+            slot[i] = 0;
+            for (int b = 1; b < k; b++)
+            {
+                if (rows[b][i] < rows[slot[i]][i])
+                    slot[i] = b;
+            }
+        }
+        return slot;
+    }
+};
+
+// Sparse road network; distance rows are computed on demand per target
+// point and cached, so memory grows with edges plus cached rows x N.
+struct RoadDistances
+{
+    RoadGraph graph;
+    std::vector<int> point_node;
+    std::vector<std::vector<double>> rows;
+    std::vector<char> row_complete;
+    std::unique_ptr<std::atomic<bool>[]> row_ready;
+    std::mutex mutex;
+};
+
+// One constraint set of a batch run
+struct Scenario
+{
+    std::string name;
+    std::string description;
+    int k = 0;
+    double min_distance_km = 2.0;
+    std::set<std::string> exclude_land_types;
+    double max_slope = 30.0;
+};
+
+// Bulk read-mostly data that copies of an optimizer share. Reads go through
+// the const accessors; write() first clones the data if another copy still
+// holds it, so copying an optimizer to run a solve copies no per-point data.
+template <typename T>
+class SharedData
+{
+private:
+    std::shared_ptr<T> value = std::make_shared<T>();
+
+public:
+    operator const T &() const { return *value; }
+    const T &get() const { return *value; }
+    T &write()
+    {
+        if (value.use_count() > 1)
+            value = std::make_shared<T>(*value);
+        return *value;
+    }
+
+    size_t size() const { return get().size(); }
+    bool empty() const { return get().empty(); }
+    auto begin() const { return get().begin(); }
+    auto end() const { return get().end(); }
+    auto data() const { return get().data(); }
+    decltype(auto) back() const { return get().back(); }
+    decltype(auto) operator[](size_t i) const { return get()[i]; }
+    template <typename K>
+    auto find(const K &key) const { return get().find(key); }
+    template <typename K>
+    size_t count(const K &key) const { return get().count(key); }
+};
+
+// Stream buffer that discards everything; backs quiet optimizers
+struct NullBuffer : std::streambuf
+{
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char *, std::streamsize count) override { return count; }
+};
+
+// Optional run instrumentation. The optimizer holds a null pointer unless
+// stats are enabled, so a disabled run pays one predictable branch per
+// counter site and no atomic traffic.
+struct RunStats
+{
+    std::atomic<uint64_t> distance_lookups{0};    // Single-pair distance lookups
+    std::atomic<uint64_t> rows_materialized{0};   // Full distance rows served
+    std::atomic<uint64_t> haversine_fallbacks{0}; // Distances computed by Haversine
+    std::atomic<uint64_t> swaps_evaluated{0};     // (candidate, slot) swaps scored
+    std::atomic<uint64_t> swaps_pruned{0};        // Candidates skipped by the min-distance check
+
+    std::mutex mutex;
+    std::vector<std::pair<std::string, double>> phases; // Seconds, in completion order
+    std::vector<std::vector<int>> accepted_swaps;       // Per swap search, accepted swaps per iteration
+
+    void add_phase(const char *name, double seconds)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        phases.emplace_back(name, seconds);
+    }
+
+    void add_search(std::vector<int> &&accepted)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        accepted_swaps.push_back(std::move(accepted));
+    }
+
+    void write_json(std::ostream &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        out << std::setprecision(6);
+        out << "{\n  \"phases\": [";
+        for (size_t i = 0; i < phases.size(); i++)
+            out << (i ? ", " : "") << "{\"name\": " << json_quote(phases[i].first) << ", \"seconds\": " << phases[i].second << "}";
+        out << "],\n  \"distance_lookups\": " << distance_lookups
+            << ",\n  \"rows_materialized\": " << rows_materialized
+            << ",\n  \"haversine_fallbacks\": " << haversine_fallbacks
+            << ",\n  \"swaps_evaluated\": " << swaps_evaluated
+            << ",\n  \"swaps_pruned\": " << swaps_pruned
+            << ",\n  \"accepted_swaps_per_iteration\": [";
+        for (size_t i = 0; i < accepted_swaps.size(); i++)
+        {
+            out << (i ? ", " : "") << "[";
+            for (size_t j = 0; j < accepted_swaps[i].size(); j++)
+                out << (j ? ", " : "") << accepted_swaps[i][j];
+            out << "]";
+        }
+        out << "]\n}\n";
+    }
+};
+
+// Records the wall time of a scope as a phase when stats are enabled
+class PhaseTimer
+{
+private:
+    RunStats *stats;
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    PhaseTimer(RunStats *run_stats, const char *phase) : stats(run_stats), name(phase)
+    {
+        if (stats)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~PhaseTimer()
+    {
+        if (stats)
+            stats->add_phase(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+};
+
+// Wall-clock and evaluation limits of one optimize() call, plus the best
+// cost reported so far. Searches check it between swap batches, so the
+// solution in hand when it runs out is complete and feasible.
+struct SearchBudget
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = Clock::time_point::max();
+    uint64_t max_evaluations = 0;         // Candidate scorings; 0 means no limit
+    std::atomic<uint64_t> evaluations{0}; // Each one an O(N) pass
+    std::atomic<bool> spent{false};
+
+    std::mutex progress_mutex;
+    double best_reported = std::numeric_limits<double>::max();
+
+    void count(uint64_t n)
+    {
+        if (max_evaluations)
+            evaluations.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    bool exhausted()
+    {
+        if (spent.load(std::memory_order_relaxed))
+            return true;
+        if ((max_evaluations && evaluations.load(std::memory_order_relaxed) >= max_evaluations) || Clock::now() >= deadline)
+        {
+            spent.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    double elapsed() const { return std::chrono::duration<double>(Clock::now() - start).count(); }
+};
+
+class KMedoidsOptimizer
+{
+private:
+    SharedData<std::vector<Point>> points;
+    SharedData<std::unordered_map<int, int>> id_to_index;
+
+    // Loaded distance data is shared between copies of the optimizer, so
+    // batch scenarios reuse one matrix and one road-row cache.
+    std::shared_ptr<DistanceMatrix> distance_matrix = std::make_shared<DistanceMatrix>(); // Road distances in meters by point position
+    std::shared_ptr<RoadDistances> road = std::make_shared<RoadDistances>();
+
+    // Hot per-point data as contiguous arrays; points keeps the full records
+    // for loading and output, and the inner loops only read these. Like the
+    // distances, they are shared between copies until a copy changes them.
+    SharedData<std::vector<double>> quantities; // resource_quantity of each point
+    std::vector<int> cost_order;                // See build_cost_order()
+    SharedData<std::vector<double>> slopes;
+    SharedData<std::vector<uint16_t>> land_codes; // Index into land_type_names
+
+    // Land types are interned so filtering compares small integers
+    SharedData<std::vector<std::string>> land_type_names;
+    SharedData<std::unordered_map<std::string, uint16_t>> land_type_codes;
+
+    // Per-point trig terms for the Haversine fallback
+    SharedData<std::vector<double>> lat_rad, lon_rad, cos_lat;
+
+    std::vector<int> valid_candidates;
+    int k;
+    double min_distance_km;
+    std::set<std::string> exclude_land_types;
+    double max_slope;
+    int num_threads = 1;
+    static constexpr size_t swap_batch_size = 256;
+    static constexpr int max_swap_iterations = 50;
+    static constexpr size_t max_conflict_graph_candidates = 32768;
+
+public:
+    enum class StorageMode
+    {
+        Dense,      // Keep the full distance source
+        Candidates, // Keep only candidate x point and candidate x candidate blocks
+        Tiled       // Stream candidate rows of a binary matrix through a bounded cache
+    };
+
+    enum class Algorithm
+    {
+        Pam,
+        Clara,
+        Clarans
+    };
+
+    enum class InitMethod
+    {
+        Random,
+        Build,
+        KMedoidsPlusPlus,
+        Lab
+    };
+
+private:
+    StorageMode storage_mode = StorageMode::Dense;
+    // Storage of CSV matrices once loaded and of written binary files
+    DistanceMatrix::DType matrix_dtype = DistanceMatrix::F64;
+    DistanceMatrix::DType binary_dtype = DistanceMatrix::F32;
+    double matrix_unit = 1.0; // Meters per U16 unit
+    InitMethod init_method = InitMethod::Random;
+    Algorithm algorithm = Algorithm::Pam;
+    int num_samples = 5;    // CLARA samples or CLARANS local searches
+    int sample_size = 0;    // CLARA sample size; 0 means 40 + 2k
+    long max_neighbors = 0; // CLARANS failed tries; 0 means max(250, 1.25% of k(C-k))
+    CandidateBlock candidate_block;
+    std::shared_ptr<TileCache> tiles; // Tiled storage, for the current candidates
+    size_t tile_cache_mb = 4096;
+    std::vector<int> candidate_position; // Position in valid_candidates, or -1
+    ConflictGraph conflicts;
+    SpatialGrid candidate_grid; // Geo-only mode with a minimum distance
+    std::vector<int> initial_medoid_ids; // Warm start, by point ID
+
+    // Center throughput limits in resource units. Quantity no center can
+    // take costs unserved_penalty meters per unit, more than any road trip.
+    enum class CapacityMode
+    {
+        None,
+        Uniform,
+        Zone // Capacity column of zone_features.csv
+    };
+    CapacityMode capacity_mode = CapacityMode::None;
+    double uniform_capacity = 0.0;
+    SharedData<std::vector<double>> zone_capacities; // By point; unlimited when blank
+    static constexpr double unserved_penalty = 1e9;
+
+    // Running solution kept current under point and quantity updates. Slots
+    // 0..N-1 are the loaded points; inserted points take the slots after
+    // them and use Haversine distances, since they have no road data.
+    // Removed points keep their slot with zero weight.
+    struct LiveState
+    {
+        std::vector<double> weights;                   // Quantity by slot
+        std::vector<double> lat_rad, lon_rad, cos_lat; // Inserted points only
+        std::unordered_map<int, int> inserted_slot;    // Point ID -> slot
+        NearestCache cache;
+        double total_weight = 0.0;
+        double reference_cost = 0.0; // Cost per unit quantity at the last refinement
+        double refine_threshold = 0.02;
+    };
+    LiveState live;
+    bool matrix_released = false;
+
+    bool verbose = true;
+    std::shared_ptr<RunStats> stats; // Null unless enable_stats(); shared by copies
+
+    std::mt19937 rng;
+    unsigned long long seed;
+    int num_restarts = 1;
+
+public:
+    // Called with the medoids (point indices), cost and elapsed seconds of
+    // each improving solution, one call at a time, from any search thread
+    using ProgressCallback = std::function<void(const std::vector<int> &medoids, double cost, double seconds)>;
+
+private:
+    double time_budget = 0.0;     // Seconds per optimize(); 0 means none
+    uint64_t max_evaluations = 0; // Candidate scorings per optimize(); 0 means none
+    ProgressCallback on_progress;
+    std::shared_ptr<SearchBudget> budget; // Live during optimize() only
+    PassScorer pass_scorer;               // Set for a distributed solve
+
+public:
+    KMedoidsOptimizer(int k_val, double min_dist, const std::set<std::string> &exclude_types, double max_slope_val)
+        : k(k_val), min_distance_km(min_dist), exclude_land_types(exclude_types), max_slope(max_slope_val)
+    {
+        set_seed(std::chrono::steady_clock::now().time_since_epoch().count());
+    }
+
+    void set_seed(unsigned long long seed_val)
+    {
+        seed = seed_val;
+        std::seed_seq seq{static_cast<unsigned>(seed), static_cast<unsigned>(seed >> 32)};
+        rng.seed(seq);
+    }
+
+    // Independent initializations + swap searches, run in parallel on --threads
+    void set_restarts(int restarts)
+    {
+        num_restarts = std::max(1, restarts);
+    }
+
+    // Anytime limits: optimize() returns the best solution found when either
+    // runs out. Searches stop between swap batches; a BUILD cut short is
+    // completed at random, so there is always a full set of medoids.
+    void set_search_budget(double seconds, uint64_t evaluations)
+    {
+        time_budget = std::max(0.0, seconds);
+        max_evaluations = evaluations;
+    }
+
+    void set_progress_callback(ProgressCallback callback)
+    {
+        on_progress = std::move(callback);
+    }
+
+    // Scores the swap passes of optimize() on remote workers
+    void set_pass_scorer(PassScorer scorer)
+    {
+        pass_scorer = std::move(scorer);
+    }
+
+    // Threads used by the swap search; 0 means one per hardware thread
+    void set_num_threads(int n)
+    {
+        num_threads = (n > 0) ? n : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void set_storage_mode(StorageMode mode)
+    {
+        storage_mode = mode;
+    }
+
+    // Memory budget of tiled storage
+    void set_tile_cache(size_t megabytes)
+    {
+        tile_cache_mb = megabytes;
+    }
+
+    // Dense matrix and binary file storage; unit is meters per U16 step
+    void set_distance_precision(DistanceMatrix::DType type, double unit)
+    {
+        matrix_dtype = type;
+        binary_dtype = type;
+        matrix_unit = unit;
+    }
+
+    void set_init_method(InitMethod method)
+    {
+        init_method = method;
+    }
+
+    void set_algorithm(Algorithm algo)
+    {
+        algorithm = algo;
+    }
+
+    Algorithm get_algorithm() const { return algorithm; }
+
+    // Sampling bounds for CLARA/CLARANS; values <= 0 keep the defaults
+    void set_sampling(int samples, int size, long neighbors)
+    {
+        if (samples > 0)
+            num_samples = samples;
+        if (size > 0)
+            sample_size = size;
+        if (neighbors > 0)
+            max_neighbors = neighbors;
+    }
+
+    // Warm start: the swap search begins from these point IDs. IDs that are
+    // unknown, filtered out or too close to an earlier one are dropped and
+    // the remaining slots are filled by the --init method.
+    void set_initial_medoids(const std::vector<int> &ids)
+    {
+        initial_medoid_ids = ids;
+    }
+
+    void set_constraints(int k_val, double min_dist, const std::set<std::string> &exclude_types, double max_slope_val)
+    {
+        k = k_val;
+        min_distance_km = min_dist;
+        exclude_land_types = exclude_types;
+        max_slope = max_slope_val;
+    }
+
+    // Every center serves at most capacity units
+    void set_uniform_capacity(double capacity)
+    {
+        capacity_mode = CapacityMode::Uniform;
+        uniform_capacity = capacity;
+    }
+
+    // Each center serves at most its zone_features.csv capacity
+    void set_zone_capacities()
+    {
+        capacity_mode = CapacityMode::Zone;
+    }
+
+    bool capacitated() const { return capacity_mode != CapacityMode::None; }
+
+    double center_capacity(int idx) const
+    {
+        if (capacity_mode == CapacityMode::Uniform)
+            return uniform_capacity;
+        if (capacity_mode == CapacityMode::Zone)
+            return zone_capacities[idx];
+        return std::numeric_limits<double>::infinity();
+    }
+
+    void enable_stats()
+    {
+        if (!stats)
+            stats = std::make_shared<RunStats>();
+    }
+
+    RunStats *get_stats() const { return stats.get(); }
+
+    // Quiet optimizers drop progress output; results are unaffected
+    void set_verbose(bool value)
+    {
+        verbose = value;
+    }
+
+    std::ostream &log() const
+    {
+        static NullBuffer null_buffer;
+        thread_local std::ostream null_stream(&null_buffer);
+        return verbose ? std::cout : null_stream;
+    }
+
+    bool load_points(const std::string &filename)
+    {
+        PhaseTimer timer(stats.get(), "load_points");
+        CsvReader csv;
+        if (!csv.open(filename))
+        {
+            std::cerr << "Error: Cannot open " << filename << std::endl;
+            return false;
+        }
+
+        csv.next_row(); // Skip header
+
+        while (csv.next_row())
+        {
+            Point p;
+
+            // Parse CSV: id,latitude,longitude,resource_quantity
+            csv.require_fields(4);
+            p.id = csv.field_int(0);
+            p.lat = csv.field_double(1);
+            p.lon = csv.field_double(2);
+            p.resource_quantity = csv.field_double(3);
+            add_loaded_point(p);
+        }
+        log() << "Loaded " << points.size() << " resource points" << std::endl;
+        return true;
+    }
+
+    uint16_t intern_land_type(const std::string &name)
+    {
+        auto it = land_type_codes.find(name);
+        if (it != land_type_codes.end())
+            return it->second;
+        if (land_type_names.size() > std::numeric_limits<uint16_t>::max())
+            throw std::runtime_error("too many distinct land types");
+        const uint16_t code = land_type_names.size();
+        land_type_names.write().push_back(name);
+        land_type_codes.write().emplace(name, code);
+        return code;
+    }
+
+    void add_loaded_point(const Point &p)
+    {
+        id_to_index.write()[p.id] = points.size();
+        points.write().push_back(p);
+        quantities.write().push_back(p.resource_quantity);
+        slopes.write().push_back(p.slope);
+        land_codes.write().push_back(intern_land_type(p.land_type));
+        zone_capacities.write().push_back(std::numeric_limits<double>::infinity());
+        lat_rad.write().push_back(p.lat * M_PI / 180.0);
+        lon_rad.write().push_back(p.lon * M_PI / 180.0);
+        cos_lat.write().push_back(cos(lat_rad.back()));
+    }
+
+    // Replaces the loaded points (with their zone features) from memory.
+    // Distances are cleared; set them afterwards.
+    void set_points(const std::vector<Point> &new_points)
+    {
+        points = {};
+        id_to_index = {};
+        quantities = {};
+        slopes = {};
+        land_codes = {};
+        zone_capacities = {};
+        lat_rad = {};
+        lon_rad = {};
+        cos_lat = {};
+        for (const Point &p : new_points)
+            add_loaded_point(p);
+        distance_matrix = std::make_shared<DistanceMatrix>();
+        road = std::make_shared<RoadDistances>();
+        reset_distance_caches();
+        candidate_position.clear();
+        live = LiveState();
+    }
+
+    // Uses a caller-owned n x n matrix in meters, in point order, without
+    // copying; row r holds the distances from every point to point r and
+    // NaN marks missing pairs. The caller keeps it alive while in use.
+    bool set_distance_matrix(const void *values, size_t n, DistanceMatrix::DType type)
+    {
+        if (n != points.size())
+        {
+            std::cerr << "Error: Distance matrix is " << n << " x " << n << " but " << points.size() << " points are loaded" << std::endl;
+            return false;
+        }
+        distance_matrix = std::make_shared<DistanceMatrix>();
+        road = std::make_shared<RoadDistances>();
+        reset_distance_caches();
+        distance_matrix->borrow(values, n, type);
+        return true;
+    }
+
+    // Drops everything derived from the distance data, for new distances
+    void reset_distance_caches()
+    {
+        candidate_block = CandidateBlock();
+        matrix_released = false;
+        tiles.reset();
+        conflicts = ConflictGraph();
+        candidate_grid = SpatialGrid();
+    }
+
+    const std::vector<Point> &get_points() const { return points; }
+    const std::vector<int> &get_valid_candidates() const { return valid_candidates; }
+
+    bool load_zone_features(const std::string &filename)
+    {
+        PhaseTimer timer(stats.get(), "load_zone_features");
+        CsvReader csv;
+        if (!csv.open(filename))
+        {
+            std::cerr << "Error: Cannot open " << filename << std::endl;
+            return false;
+        }
+
+        csv.next_row(); // Skip header
+
+        // Merge zone features straight into the matching points
+        size_t zone_count = 0;
+        while (csv.next_row())
+        {
+            // Parse CSV: id,slope,elevation,land_type[,capacity]
+            csv.require_fields(4);
+            int id = csv.field_int(0);
+            double slope = csv.field_double(1);
+            double elevation = csv.field_double(2);
+            zone_count++;
+
+            auto it = id_to_index.find(id);
+            if (it != id_to_index.end())
+            {
+                Point &point = points.write()[it->second];
+                point.land_type = std::string(csv.field(3));
+                point.slope = slope;
+                point.elevation = elevation;
+                slopes.write()[it->second] = slope;
+                land_codes.write()[it->second] = intern_land_type(point.land_type);
+                if (csv.field_count() > 4 && !csv.field(4).empty())
+                    zone_capacities.write()[it->second] = csv.field_double(4);
+            }
+        }
+        log() << "Loaded zone features for " << zone_count << " locations" << std::endl;
+        return true;
+    }
+
+    // Loads a dense road matrix, either a CSV in km or a binary matrix file,
+    // or an edge list; false after reporting a file that cannot be read
+    bool load_distances(const std::string &filename)
+    {
+        PhaseTimer timer(stats.get(), "load_distances");
+        if (!std::ifstream(filename, std::ios::binary).is_open())
+        {
+            std::cerr << "Error: Cannot open " << filename << std::endl;
+            return false;
+        }
+
+        reset_distance_caches();
+
+        if (is_binary_matrix(filename))
+        {
+            return load_distances_binary(filename);
+        }
+
+        CsvReader csv;
+        if (!csv.open(filename))
+        {
+            std::cerr << "Error: Cannot open " << filename << std::endl;
+            return false;
+        }
+
+        csv.next_row(); // Header with point IDs
+
+        if (is_edge_list_header(csv))
+        {
+            load_road_graph(csv);
+            return true;
+        }
+
+        road = std::make_shared<RoadDistances>();
+        distance_matrix = std::make_shared<DistanceMatrix>();
+        const size_t n = points.size();
+        distance_matrix->allocate(n, matrix_dtype, matrix_unit);
+
+        // Row label, then one cell per column; empty cells are missing pairs
+        size_t row = 0;
+        while (csv.next_row() && row < n)
+        {
+            const size_t cols = std::min(csv.field_count() - 1, n);
+            for (size_t col = 0; col < cols; col++)
+            {
+                if (!csv.field(col + 1).empty() &&
+                    !distance_matrix->set(row, col, csv.field_double(col + 1) * 1000)) // Convert km to meters
+                {
+                    csv.fail("distance does not fit u16; use a larger --distance-precision u16:<meters>");
+                }
+            }
+            row++;
+        }
+
+        distance_matrix->finalize_rows();
+        log() << "Loaded distance matrix" << std::endl;
+        return true;
+    }
+
+    static bool is_binary_matrix(const std::string &filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        char magic[sizeof(binary_matrix_magic)] = {};
+        file.read(magic, sizeof(magic));
+        return std::memcmp(magic, binary_matrix_magic, sizeof(magic)) == 0;
+    }
+
+    // A dense CSV matrix, which has no rows to map or compute on demand
+    static bool is_dense_csv_matrix(const std::string &filename)
+    {
+        CsvReader csv;
+        return !is_binary_matrix(filename) && csv.open(filename) && csv.next_row() && !is_edge_list_header(csv);
+    }
+
+    // From_ID,To_ID,Distance header of a sparse edge list
+    static bool is_edge_list_header(const CsvReader &csv)
+    {
+        if (csv.field_count() != 3)
+            return false;
+        auto starts_with = [](std::string_view field, std::string_view prefix)
+        {
+            if (field.size() < prefix.size())
+                return false;
+            for (size_t i = 0; i < prefix.size(); i++)
+            {
+                if (std::tolower(static_cast<unsigned char>(field[i])) != prefix[i])
+                    return false;
+            }
+            return true;
+        };
+        return starts_with(csv.field(0), "from") && starts_with(csv.field(1), "to");
+    }
+
+    // Reads the rows of a From_ID,To_ID,Distance edge list (meters) into CSR
+    void load_road_graph(CsvReader &csv)
+    {
+        std::vector<std::pair<int, int>> edges;
+        std::vector<double> lengths;
+        while (csv.next_row())
+        {
+            csv.require_fields(3);
+            edges.push_back({csv.field_int(0), csv.field_int(1)});
+            lengths.push_back(csv.field_double(2));
+            if (lengths.back() < 0)
+                csv.fail("negative road length");
+        }
+
+        distance_matrix = std::make_shared<DistanceMatrix>();
+        road = std::make_shared<RoadDistances>();
+        road->graph.build(edges, lengths);
+
+        const size_t n = points.size();
+        road->point_node.resize(n);
+        for (size_t i = 0; i < n; i++)
+            road->point_node[i] = road->graph.node_of(points[i].id);
+        road->rows.assign(n, std::vector<double>());
+        road->row_complete.assign(n, 0);
+        road->row_ready.reset(new std::atomic<bool>[n]);
+        for (size_t i = 0; i < n; i++)
+            road->row_ready[i] = false;
+
+        log() << "Loaded road network with " << road->graph.node_count() << " nodes and "
+                  << edges.size() << " edges" << std::endl;
+    }
+
+    // Road distances from every point to point to_idx over the graph; pairs
+    // that are not connected stay NaN and fall back to Haversine.
+    void compute_graph_row(int to_idx, std::vector<double> &node_dist, std::vector<double> &row) const
+    {
+        const size_t n = points.size();
+        row.assign(n, std::numeric_limits<double>::quiet_NaN());
+        if (road->point_node[to_idx] < 0)
+            return;
+
+        road->graph.shortest_paths(road->point_node[to_idx], node_dist);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (road->point_node[i] >= 0 && node_dist[road->point_node[i]] != std::numeric_limits<double>::infinity())
+                row[i] = node_dist[road->point_node[i]];
+        }
+    }
+
+    // Callers hold road->mutex; a row is never rewritten once published
+    void store_graph_row(int to_idx, std::vector<double> &&row) const
+    {
+        if (road->row_ready[to_idx].load(std::memory_order_relaxed))
+            return;
+        road->row_complete[to_idx] = std::none_of(row.begin(), row.end(), [](double d) { return std::isnan(d); });
+        road->rows[to_idx] = std::move(row);
+        road->row_ready[to_idx].store(true, std::memory_order_release);
+    }
+
+    // Cached graph row for to_idx, computing it first if needed
+    const std::vector<double> &graph_row(int to_idx) const
+    {
+        if (!road->row_ready[to_idx].load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lock(road->mutex);
+            if (!road->row_ready[to_idx].load(std::memory_order_relaxed))
+            {
+                std::vector<double> node_dist, row;
+                compute_graph_row(to_idx, node_dist, row);
+                store_graph_row(to_idx, std::move(row));
+            }
+        }
+        return road->rows[to_idx];
+    }
+
+    // Runs Dijkstra for every target that is not cached yet, in parallel
+    void prepare_graph_rows(const std::vector<int> &targets)
+    {
+        if (road->graph.empty())
+            return;
+
+        std::vector<int> pending;
+        for (int t : targets)
+        {
+            if (!road->row_ready[t].load(std::memory_order_relaxed))
+                pending.push_back(t);
+        }
+
+        ThreadPool pool(num_threads);
+        std::vector<std::vector<double>> node_dist(pool.size());
+        pool.parallel_for(pending.size(), [&](size_t i, int worker)
+        {
+            std::vector<double> row;
+            compute_graph_row(pending[i], node_dist[worker], row);
+            std::lock_guard<std::mutex> lock(road->mutex);
+            store_graph_row(pending[i], std::move(row));
+        });
+
+        if (!pending.empty())
+            log() << "Computed road distances for " << pending.size() << " candidates" << std::endl;
+    }
+
+    bool load_distances_binary(const std::string &filename)
+    {
+        road = std::make_shared<RoadDistances>();
+        distance_matrix = std::make_shared<DistanceMatrix>();
+        std::vector<int> ids;
+        if (!distance_matrix->map_binary(filename, ids))
+        {
+            distance_matrix->reset();
+            return false;
+        }
+
+        const size_t n = points.size();
+        bool same_order = (ids.size() == n);
+        for (size_t i = 0; same_order && i < n; i++)
+        {
+            same_order = (ids[i] == points[i].id);
+        }
+
+        if (same_order)
+        {
+            log() << "Loaded distance matrix (memory-mapped, " << n << " points)" << std::endl;
+            return true;
+        }
+
+        // Point order differs from the file; copy into point order
+        std::vector<int> file_index(n, -1);
+        for (size_t f = 0; f < ids.size(); f++)
+        {
+            auto it = id_to_index.find(ids[f]);
+            if (it != id_to_index.end())
+                file_index[it->second] = f;
+        }
+
+        // Keeps the file's storage type; values decode and re-encode exactly
+        auto mapped = distance_matrix;
+        distance_matrix = std::make_shared<DistanceMatrix>();
+        distance_matrix->allocate(n, mapped->type(), mapped->unit());
+        for (size_t r = 0; r < n; r++)
+        {
+            if (file_index[r] < 0)
+                continue;
+            for (size_t c = 0; c < n; c++)
+            {
+                if (file_index[c] >= 0)
+                    distance_matrix->set(c, r, mapped->at(file_index[c], file_index[r]));
+            }
+        }
+        distance_matrix->finalize_rows();
+        log() << "Loaded distance matrix (reordered from " << filename << ")" << std::endl;
+        return true;
+    }
+
+    // Writes the loaded matrix as a binary file for fast, mmap-able startup
+    bool save_distances_binary(const std::string &filename) const
+    {
+        if (distance_matrix->empty())
+        {
+            std::cerr << "Error: No distance matrix loaded" << std::endl;
+            return false;
+        }
+
+        std::vector<int> ids;
+        for (const auto &p : points)
+            ids.push_back(p.id);
+        return distance_matrix->write_binary(filename, ids, binary_dtype, matrix_unit);
+    }
+
+    double get_distance(int from_id, int to_id)
+    {
+        auto from_it = id_to_index.find(from_id);
+        auto to_it = id_to_index.find(to_id);
+        if (from_it != id_to_index.end() && to_it != id_to_index.end())
+        {
+            return get_distance_idx(from_it->second, to_it->second);
+        }
+
+        // Unknown IDs fall back to Haversine from the default point
+        Point from_point, to_point;
+        if (from_it != id_to_index.end())
+            from_point = points[from_it->second];
+        if (to_it != id_to_index.end())
+            to_point = points[to_it->second];
+
+        return haversine_distance(from_point.lat, from_point.lon, to_point.lat, to_point.lon);
+    }
+
+    // Fast path on point positions; used by every cost and constraint loop
+    double get_distance_idx(int from_idx, int to_idx) const
+    {
+        if (RunStats *s = stats.get())
+            s->distance_lookups.fetch_add(1, std::memory_order_relaxed);
+        if (!candidate_block.empty() && candidate_block.position[to_idx] >= 0)
+        {
+            const int to_pos = candidate_block.position[to_idx];
+            const int from_pos = candidate_block.position[from_idx];
+            if (from_pos >= 0 && !candidate_block.pairs.empty())
+                return candidate_block.pairs[static_cast<size_t>(to_pos) * candidate_block.candidates.size() + from_pos];
+            return candidate_block.row(to_pos, points.size())[from_idx];
+        }
+
+        if (!road->graph.empty())
+        {
+            double dist = graph_row(to_idx)[from_idx];
+            if (!std::isnan(dist))
+            {
+                return dist;
+            }
+        }
+        else if (!distance_matrix->empty())
+        {
+            double dist = distance_matrix->at(from_idx, to_idx);
+            if (!std::isnan(dist))
+            {
+                return dist;
+            }
+        }
+
+        if (RunStats *s = stats.get())
+            s->haversine_fallbacks.fetch_add(1, std::memory_order_relaxed);
+        return haversine_idx(from_idx, to_idx);
+    }
+
+    // Haversine between two loaded points using the cached trig terms
+    double haversine_idx(int from_idx, int to_idx) const
+    {
+        const double R = 6371000; // Earth radius in meters
+        double sdlat = sin((lat_rad[to_idx] - lat_rad[from_idx]) / 2);
+        double sdlon = sin((lon_rad[to_idx] - lon_rad[from_idx]) / 2);
+        double a = sdlat * sdlat + cos_lat[from_idx] * cos_lat[to_idx] * sdlon * sdlon;
+        return R * 2 * atan2(sqrt(a), sqrt(1 - a));
+    }
+
+    // Haversine from precomputed terms, in the operand order of haversine_row
+    static double haversine_terms(double src_lat, double src_lon, double src_cos, double lat, double lon, double cos)
+    {
+        const double R = 6371000;
+        double sdlat = sin((lat - src_lat) / 2);
+        double sdlon = sin((lon - src_lon) / 2);
+        double a = sdlat * sdlat + src_cos * cos * sdlon * sdlon;
+        return R * 2 * atan2(sqrt(a), sqrt(1 - a));
+    }
+
+    // d(point, source) exactly as haversine_row(source) computes it
+    double haversine_from(int source_idx, int point_idx) const
+    {
+        return haversine_terms(lat_rad[source_idx], lon_rad[source_idx], cos_lat[source_idx],
+                               lat_rad[point_idx], lon_rad[point_idx], cos_lat[point_idx]);
+    }
+
+    // With no road data every distance is Haversine, so a spatial grid can
+    // bound which points a candidate or medoid can affect
+    bool geo_only() const
+    {
+        return candidate_block.empty() && distance_matrix->empty() && road->graph.empty();
+    }
+
+    SpatialGrid build_grid(const std::vector<int> &indices, size_t per_cell) const
+    {
+        SpatialGrid grid;
+        if (indices.empty())
+            return grid;
+
+        double lat_min = lat_rad[indices[0]], lat_max = lat_min, lon_min = lon_rad[indices[0]], lon_max = lon_min;
+        for (int i : indices)
+        {
+            lat_min = std::min(lat_min, lat_rad[i]);
+            lat_max = std::max(lat_max, lat_rad[i]);
+            lon_min = std::min(lon_min, lon_rad[i]);
+            lon_max = std::max(lon_max, lon_rad[i]);
+        }
+
+        // Roughly square cells of about per_cell points each
+        const double height = std::max(lat_max - lat_min, 1e-9);
+        const double width = std::max((lon_max - lon_min) * std::cos((lat_min + lat_max) / 2), 1e-9);
+        const double target = std::max(1.0, static_cast<double>(indices.size()) / per_cell);
+        const int rows = std::clamp(static_cast<int>(std::round(std::sqrt(target * height / width))), 1, 4096);
+        const int cols = std::clamp(static_cast<int>(std::round(target / rows)), 1, 4096);
+        auto cell_of = [&](int i)
+        {
+            const int r = std::min(rows - 1, static_cast<int>((lat_rad[i] - lat_min) / height * rows));
+            const int c = std::min(cols - 1, static_cast<int>((lon_rad[i] - lon_min) / std::max(lon_max - lon_min, 1e-9) * cols));
+            return r * cols + c;
+        };
+
+        // Counting sort of the members by cell
+        std::vector<int> count(rows * cols + 1, 0);
+        for (int i : indices)
+            count[cell_of(i) + 1]++;
+        for (size_t c = 1; c < count.size(); c++)
+            count[c] += count[c - 1];
+        std::vector<int> start = count;
+        grid.members.resize(indices.size());
+        for (int i : indices)
+            grid.members[count[cell_of(i)]++] = i;
+
+        // Drop empty cells, then fit a bounding circle around each
+        for (int c = 0; c < rows * cols; c++)
+        {
+            const int first = start[c], last = start[c + 1];
+            if (first == last)
+                continue;
+            double lat = 0.0, lon = 0.0;
+            for (int m = first; m < last; m++)
+            {
+                lat += lat_rad[grid.members[m]];
+                lon += lon_rad[grid.members[m]];
+            }
+            lat /= last - first;
+            lon /= last - first;
+            double radius = 0.0;
+            for (int m = first; m < last; m++)
+            {
+                const int i = grid.members[m];
+                radius = std::max(radius, haversine_terms(lat, lon, std::cos(lat), lat_rad[i], lon_rad[i], cos_lat[i]));
+            }
+            grid.cell_start.push_back(first);
+            grid.center_lat.push_back(lat);
+            grid.center_lon.push_back(lon);
+            grid.center_cos.push_back(std::cos(lat));
+            grid.radius.push_back(radius * (1 + 1e-9) + 1e-3); // Slack for rounding
+        }
+        grid.cell_start.push_back(indices.size());
+        return grid;
+    }
+
+    // Calls fn(member) for every member of the cells that may hold a point
+    // within reach(cell) meters of x
+    template <typename Reach, typename Fn>
+    void visit_near(const SpatialGrid &grid, int x, Reach &&reach, Fn &&fn) const
+    {
+        for (size_t c = 0; c < grid.cells(); c++)
+        {
+            const double lower = haversine_terms(grid.center_lat[c], grid.center_lon[c], grid.center_cos[c],
+                                                 lat_rad[x], lon_rad[x], cos_lat[x]) - grid.radius[c];
+            if (lower > reach(c))
+                continue;
+            for (int m = grid.cell_start[c]; m < grid.cell_start[c + 1]; m++)
+                fn(grid.members[m]);
+        }
+    }
+
+    // Haversine from one source point to many targets; out[t] = d(source, targets[t])
+    void haversine_batch(int source_idx, const int *targets, size_t count, double *out) const
+    {
+        if (RunStats *s = stats.get())
+            s->haversine_fallbacks.fetch_add(count, std::memory_order_relaxed);
+        const double R = 6371000;
+        const double src_lat = lat_rad[source_idx];
+        const double src_lon = lon_rad[source_idx];
+        const double src_cos = cos_lat[source_idx];
+        for (size_t t = 0; t < count; t++)
+        {
+            int j = targets[t];
+            double sdlat = sin((lat_rad[j] - src_lat) / 2);
+            double sdlon = sin((lon_rad[j] - src_lon) / 2);
+            double a = sdlat * sdlat + src_cos * cos_lat[j] * sdlon * sdlon;
+            out[t] = R * 2 * atan2(sqrt(a), sqrt(1 - a));
+        }
+    }
+
+    // Haversine from one source point to every point; out must hold points.size() values
+    void haversine_row(int source_idx, double *out) const
+    {
+        if (RunStats *s = stats.get())
+            s->haversine_fallbacks.fetch_add(points.size(), std::memory_order_relaxed);
+        const double R = 6371000;
+        const double src_lat = lat_rad[source_idx];
+        const double src_lon = lon_rad[source_idx];
+        const double src_cos = cos_lat[source_idx];
+        const size_t n = points.size();
+        for (size_t j = 0; j < n; j++)
+        {
+            double sdlat = sin((lat_rad[j] - src_lat) / 2);
+            double sdlon = sin((lon_rad[j] - src_lon) / 2);
+            double a = sdlat * sdlat + src_cos * cos_lat[j] * sdlon * sdlon;
+            out[j] = R * 2 * atan2(sqrt(a), sqrt(1 - a));
+        }
+    }
+
+    // Distances from every point to to_idx. Returns a pointer into the matrix
+    // when a complete double row can be used in place, otherwise fills buf and
+    // patches missing pairs with batched Haversine.
+    const double *distance_row(int to_idx, RowBuffer &buf) const
+    {
+        const size_t n = points.size();
+        if (RunStats *s = stats.get())
+            s->rows_materialized.fetch_add(1, std::memory_order_relaxed);
+        if (!candidate_block.empty() && candidate_block.position[to_idx] >= 0)
+        {
+            return candidate_block.row(candidate_block.position[to_idx], n);
+        }
+
+        buf.values.resize(n);
+        if (tiles && candidate_position[to_idx] >= 0)
+        {
+            const char *row = tiles->row(candidate_position[to_idx], buf.pinned);
+            const bool complete = distance_matrix->row_complete(to_idx);
+            if (distance_matrix->type() == DistanceMatrix::F32)
+                return materialize_row(reinterpret_cast<const float *>(row), complete, to_idx, buf);
+            if (distance_matrix->type() == DistanceMatrix::U16)
+                return materialize_row(reinterpret_cast<const uint16_t *>(row), complete, to_idx, buf);
+            return materialize_row(reinterpret_cast<const double *>(row), complete, to_idx, buf);
+        }
+        if (!road->graph.empty())
+        {
+            const double *row = graph_row(to_idx).data();
+            return materialize_row(row, road->row_complete[to_idx], to_idx, buf);
+        }
+
+        if (distance_matrix->empty())
+        {
+            haversine_row(to_idx, buf.values.data());
+            return buf.values.data();
+        }
+
+        const bool complete = distance_matrix->row_complete(to_idx);
+        if (distance_matrix->type() == DistanceMatrix::F32)
+            return materialize_row(distance_matrix->row_f32(to_idx), complete, to_idx, buf);
+        if (distance_matrix->type() == DistanceMatrix::U16)
+            return materialize_row(distance_matrix->row_u16(to_idx), complete, to_idx, buf);
+        return materialize_row(distance_matrix->row_f64(to_idx), complete, to_idx, buf);
+    }
+
+    template <typename T>
+    const double *materialize_row(const T *row, bool complete, int to_idx, RowBuffer &buf) const
+    {
+        const size_t n = points.size();
+        if constexpr (std::is_same<T, double>::value)
+        {
+            if (complete)
+                return row;
+        }
+
+        buf.missing.clear();
+        for (size_t j = 0; j < n; j++)
+        {
+            if constexpr (std::is_same<T, uint16_t>::value)
+                buf.values[j] = distance_matrix->decode(row[j]);
+            else
+                buf.values[j] = row[j];
+            if (!complete && std::isnan(buf.values[j]))
+                buf.missing.push_back(j);
+        }
+        buf.patch.resize(buf.missing.size());
+        haversine_batch(to_idx, buf.missing.data(), buf.missing.size(), buf.patch.data());
+        for (size_t t = 0; t < buf.missing.size(); t++)
+        {
+            buf.values[buf.missing[t]] = buf.patch[t];
+        }
+        return buf.values.data();
+    }
+
+    static double haversine_distance(double lat1, double lon1, double lat2, double lon2)
+    {
+        const double R = 6371000; // Earth radius in meters
+        double dlat = (lat2 - lat1) * M_PI / 180.0;
+        double dlon = (lon2 - lon1) * M_PI / 180.0;
+        double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1 * M_PI / 180.0) * cos(lat2 * M_PI / 180.0) * sin(dlon / 2) * sin(dlon / 2);
+        double c = 2 * atan2(sqrt(a), sqrt(1 - a));
+        return R * c;
+    }
+
+    void filter_candidates()
+    {
+        valid_candidates.clear();
+
+        // Resolve the excluded names to codes once
+        std::vector<char> excluded(land_type_names.size(), 0);
+        for (size_t code = 0; code < land_type_names.size(); code++)
+            excluded[code] = exclude_land_types.count(land_type_names[code]) > 0;
+
+        for (int i = 0; i < points.size(); i++)
+        {
+            // Check land type exclusions
+            if (excluded[land_codes[i]])
+            {
+                continue;
+            }
+
+            // Check slope constraint
+            if (slopes[i] > max_slope)
+            {
+                continue;
+            }
+
+            valid_candidates.push_back(i);
+        }
+
+        candidate_position.assign(points.size(), -1);
+        for (size_t c = 0; c < valid_candidates.size(); c++)
+            candidate_position[valid_candidates[c]] = c;
+        tiles.reset();
+
+        log() << "Valid candidates after filtering: " << valid_candidates.size() << std::endl;
+    }
+
+    // Builds the candidate conflict graph for the current candidates and
+    // min_distance_km; a no-op when it is already up to date
+    void build_conflict_graph()
+    {
+        const double min_distance_m = min_distance_km * 1000; // Convert km to meters
+        if (conflicts.candidates == valid_candidates && conflicts.min_distance_m == min_distance_m)
+            return;
+
+        const size_t c = valid_candidates.size();
+        conflicts.candidates = valid_candidates;
+        conflicts.min_distance_m = min_distance_m;
+        conflicts.words = (c + 63) / 64;
+        conflicts.bits.clear();
+        candidate_grid = (geo_only() && min_distance_m > 0) ? build_grid(valid_candidates, 16) : SpatialGrid();
+        if (min_distance_m <= 0 || c == 0 || c > max_conflict_graph_candidates)
+            return; // Large candidate sets test distances directly instead
+
+        conflicts.bits.assign(c * conflicts.words, 0);
+        ThreadPool pool(num_threads);
+        if (geo_only())
+        {
+            // Only candidates in nearby cells can be too close
+            pool.parallel_for(c, [&](size_t a, int)
+            {
+                uint64_t *row = &conflicts.bits[a * conflicts.words];
+                visit_near(candidate_grid, valid_candidates[a], [&](size_t) { return min_distance_m; }, [&](int idx)
+                {
+                    const int b = candidate_position[idx];
+                    if (b != a && haversine_idx(valid_candidates[a], idx) < min_distance_m)
+                        row[b >> 6] |= uint64_t(1) << (b & 63);
+                });
+            });
+            return;
+        }
+        pool.parallel_for(c, [&](size_t a, int)
+        {
+            uint64_t *row = &conflicts.bits[a * conflicts.words];
+            for (size_t b = 0; b < c; b++)
+            {
+                if (a == b)
+                    continue;
+                if (get_distance_idx(valid_candidates[a], valid_candidates[b]) < min_distance_m ||
+                    get_distance_idx(valid_candidates[b], valid_candidates[a]) < min_distance_m)
+                {
+                    row[b >> 6] |= uint64_t(1) << (b & 63);
+                }
+            }
+        });
+    }
+
+    bool min_distance_active() const
+    {
+        return min_distance_km > 0;
+    }
+
+    // Whether candidates at positions a and b are too close to both be medoids
+    bool candidates_conflict(int a, int b) const
+    {
+        if (conflicts.enabled())
+            return conflicts.test(a, b);
+        const double min_distance_m = min_distance_km * 1000;
+        return a != b && (get_distance_idx(valid_candidates[a], valid_candidates[b]) < min_distance_m ||
+                          get_distance_idx(valid_candidates[b], valid_candidates[a]) < min_distance_m);
+    }
+
+    bool satisfies_min_distance(const std::vector<int> &medoids, int new_candidate)
+    {
+        build_conflict_graph();
+        if (!min_distance_active())
+            return true;
+
+        const int pos = candidate_position[new_candidate];
+        for (int medoid_idx : medoids)
+        {
+            if (candidates_conflict(pos, candidate_position[medoid_idx]))
+                return false;
+        }
+        return true;
+    }
+
+    // A complete float32 matrix row read in place by the cost kernels, or null
+    const float *f32_row(int to_idx) const
+    {
+        if (!candidate_block.empty() || tiles || !road->graph.empty() || distance_matrix->empty() ||
+            distance_matrix->type() != DistanceMatrix::F32 || !distance_matrix->row_complete(to_idx))
+            return nullptr;
+        if (RunStats *s = stats.get())
+            s->rows_materialized.fetch_add(1, std::memory_order_relaxed);
+        return distance_matrix->row_f32(to_idx);
+    }
+
+    // Scratch of calculate_total_cost() and get_assignments() for callers
+    // that evaluate many medoid sets
+    struct CostScratch
+    {
+        std::vector<double> min_dist;
+        RowBuffer buf;
+        std::vector<RowBuffer> bufs; // One per medoid, for bounded_total_cost()
+        std::vector<const double *> rows;
+        std::vector<const float *> f32_rows;
+    };
+
+    double calculate_total_cost(const std::vector<int> &medoids) const
+    {
+        CostScratch scratch;
+        return calculate_total_cost(medoids, scratch);
+    }
+
+    double calculate_total_cost(const std::vector<int> &medoids, CostScratch &scratch) const
+    {
+        const size_t n = points.size();
+        const CostKernels &kernels = *active_kernels();
+        std::vector<double> &min_dist = scratch.min_dist;
+        min_dist.assign(n, std::numeric_limits<double>::max());
+
+        for (int medoid_idx : medoids)
+        {
+            if (const float *row = f32_row(medoid_idx))
+                kernels.min_f32(min_dist.data(), row, n);
+            else
+                kernels.min_f64(min_dist.data(), distance_row(medoid_idx, scratch.buf), n);
+        }
+
+        return kernels.weighted_sum(min_dist.data(), quantities.data(), n);
+    }
+
+    // Points by descending quantity, ties by index, so bounded cost sums
+    // meet the big contributors first
+    void build_cost_order()
+    {
+        cost_order.resize(points.size());
+        std::iota(cost_order.begin(), cost_order.end(), 0);
+        std::stable_sort(cost_order.begin(), cost_order.end(), [&](int a, int b) { return quantities[a] > quantities[b]; });
+    }
+
+    // calculate_total_cost() that visits points in cost_order and stops once
+    // the partial sum reaches bound, returning that partial sum. Every term is
+    // non-negative, so a stopped medoid set can never come in under bound.
+    // Used by CLARA only; the swap search scores by FastPAM deltas instead.
+    // Dense rows are read in place and geo-only distances per visited point,
+    // but road-graph and tiled rows are built or staged in full first, so
+    // there the abort saves only the summation.
+    double bounded_total_cost(const std::vector<int> &medoids, double bound, CostScratch &scratch) const
+    {
+        const size_t n = points.size();
+        const size_t check_every = 256;
+        auto sum = [&](auto &&distance)
+        {
+            double total = 0.0;
+            for (size_t t = 0; t < n; t++)
+            {
+                const int i = cost_order[t];
+                double nearest = std::numeric_limits<double>::max();
+                for (size_t j = 0; j < medoids.size(); j++)
+                    nearest = std::min(nearest, distance(j, i));
+                total += quantities[i] * nearest;
+                if (t % check_every == check_every - 1 && total >= bound)
+                    return total;
+            }
+            return total;
+        };
+
+        // Haversine distances are computed only for the points visited
+        if (geo_only())
+            return sum([&](size_t j, int i) { return haversine_from(medoids[j], i); });
+
+        bool all_f32 = true;
+        scratch.f32_rows.resize(medoids.size());
+        for (size_t j = 0; j < medoids.size(); j++)
+        {
+            scratch.f32_rows[j] = f32_row(medoids[j]);
+            all_f32 = all_f32 && scratch.f32_rows[j];
+        }
+        if (all_f32)
+            return sum([&](size_t j, int i) { return static_cast<double>(scratch.f32_rows[j][i]); });
+
+        scratch.bufs.resize(std::max(scratch.bufs.size(), medoids.size()));
+        scratch.rows.resize(medoids.size());
+        for (size_t j = 0; j < medoids.size(); j++)
+            scratch.rows[j] = distance_row(medoids[j], scratch.bufs[j]);
+        return sum([&](size_t j, int i) { return scratch.rows[j][i]; });
+    }
+
+    std::vector<int> get_assignments(const std::vector<int> &medoids) const
+    {
+        std::vector<int> assignments;
+        CostScratch scratch;
+        get_assignments(medoids, assignments, scratch);
+        return assignments;
+    }
+
+    // Capacitated cost of medoids without the overflow penalty
+    double transport_cost(const std::vector<int> &medoids) const
+    {
+        std::vector<RowBuffer> bufs;
+        CapacitatedAssignment flow;
+        solve_capacitated(full_problem(), medoids, bufs, flow);
+        return flow.transport_cost();
+    }
+
+    void get_assignments(const std::vector<int> &medoids, std::vector<int> &assignments, CostScratch &scratch) const
+    {
+        if (capacitated())
+        {
+            std::vector<RowBuffer> bufs;
+            CapacitatedAssignment flow;
+            solve_capacitated(full_problem(), medoids, bufs, flow);
+            assignments = flow.assignments();
+            return;
+        }
+
+        const size_t n = points.size();
+        const CostKernels &kernels = *active_kernels();
+        assignments.assign(n, -1);
+        std::vector<double> &min_dist = scratch.min_dist;
+        min_dist.assign(n, std::numeric_limits<double>::max());
+
+        for (int j = 0; j < medoids.size(); j++)
+        {
+            if (const float *row = f32_row(medoids[j]))
+                kernels.argmin_f32(min_dist.data(), assignments.data(), row, j, n);
+            else
+                kernels.argmin_f64(min_dist.data(), assignments.data(), distance_row(medoids[j], scratch.buf), j, n);
+        }
+    }
+
+    // Medoids chosen so far plus the candidates they rule out
+    struct Selection
+    {
+        std::vector<int> medoids;
+        std::vector<uint64_t> excluded; // By candidate position
+
+        bool available(size_t pos) const { return !((excluded[pos >> 6] >> (pos & 63)) & 1); }
+    };
+
+    Selection start_selection() const
+    {
+        Selection sel;
+        sel.excluded.assign((valid_candidates.size() + 63) / 64, 0);
+        return sel;
+    }
+
+    void select_candidate(Selection &sel, int pos) const
+    {
+        sel.medoids.push_back(valid_candidates[pos]);
+        sel.excluded[pos >> 6] |= uint64_t(1) << (pos & 63);
+        if (conflicts.enabled())
+        {
+            const uint64_t *row = conflicts.row(pos);
+            for (size_t w = 0; w < conflicts.words; w++)
+                sel.excluded[w] |= row[w];
+        }
+        else if (candidate_grid.cells() > 0)
+        {
+            const double min_distance_m = min_distance_km * 1000;
+            visit_near(candidate_grid, valid_candidates[pos], [&](size_t) { return min_distance_m; }, [&](int idx)
+            {
+                const int other = candidate_position[idx];
+                if (candidates_conflict(pos, other))
+                    sel.excluded[other >> 6] |= uint64_t(1) << (other & 63);
+            });
+        }
+        else if (min_distance_active())
+        {
+            for (size_t other = 0; other < valid_candidates.size(); other++)
+            {
+                if (candidates_conflict(pos, other))
+                    sel.excluded[other >> 6] |= uint64_t(1) << (other & 63);
+            }
+        }
+    }
+
+    std::vector<int> initialize_medoids()
+    {
+        build_conflict_graph();
+        ThreadPool pool(num_threads);
+        return initialize_medoids(rng, pool);
+    }
+
+    // Initial medoids drawn with gen; the conflict graph must be up to date.
+    // Only reads shared state, so independent restarts can run concurrently.
+    std::vector<int> initialize_medoids(std::mt19937 &gen, ThreadPool &pool) const
+    {
+        Selection sel = start_selection();
+        seed_initial_medoids(sel);
+        switch (init_method)
+        {
+        case InitMethod::Build:
+            initialize_build(sel, pool);
+            break;
+        case InitMethod::KMedoidsPlusPlus:
+            initialize_kmedoids_pp(sel, gen);
+            break;
+        case InitMethod::Lab:
+            initialize_lab(sel, gen);
+            if (sel.medoids.size() < k && !budget_spent())
+                initialize_build(sel, pool);
+            break;
+        default:
+            initialize_random(sel, gen);
+            break;
+        }
+
+        if (sel.medoids.size() < k && budget_spent())
+        {
+            log() << "Search budget spent during initialization; choosing the remaining "
+                  << k - sel.medoids.size() << " medoids at random" << std::endl;
+            initialize_random(sel, gen);
+        }
+        if (sel.medoids.size() < k)
+        {
+            log() << "Warning: Cannot find " << k << " medoids satisfying distance constraint" << std::endl;
+        }
+        return sel.medoids;
+    }
+
+    // Adds the feasible warm-start medoids to sel, in the order given
+    void seed_initial_medoids(Selection &sel) const
+    {
+        for (int id : initial_medoid_ids)
+        {
+            if (sel.medoids.size() >= k)
+                break;
+            auto it = id_to_index.find(id);
+            if (it == id_to_index.end())
+                continue;
+            const int pos = candidate_position[it->second];
+            if (pos >= 0 && sel.available(pos))
+                select_candidate(sel, pos);
+        }
+    }
+
+    // Uniform choice among the feasible candidates
+    void initialize_random(Selection &sel, std::mt19937 &gen) const
+    {
+        std::vector<int> valid_next;
+        valid_next.reserve(valid_candidates.size());
+        while (sel.medoids.size() < k)
+        {
+            valid_next.clear();
+            for (size_t pos = 0; pos < valid_candidates.size(); pos++)
+            {
+                if (sel.available(pos))
+                    valid_next.push_back(pos);
+            }
+
+            if (valid_next.empty())
+                break;
+
+            std::uniform_int_distribution<int> dist(0, valid_next.size() - 1);
+            select_candidate(sel, valid_next[dist(gen)]);
+        }
+    }
+
+    // PAM BUILD: greedily add the feasible candidate that lowers the total
+    // cost the most. O(k * C * N), with candidates scored in parallel.
+    void initialize_build(Selection &sel, ThreadPool &pool) const
+    {
+        const size_t n = points.size();
+        const size_t c = valid_candidates.size();
+        std::vector<double> nearest(n, std::numeric_limits<double>::max());
+        std::vector<double> gain(c);
+
+        std::vector<RowBuffer> bufs(pool.size());
+        RowBuffer buf;
+        for (int m : sel.medoids)
+        {
+            const double *row = distance_row(m, buf);
+            for (size_t i = 0; i < n; i++)
+                nearest[i] = std::min(nearest[i], row[i]);
+        }
+
+        while (sel.medoids.size() < k && !budget_spent())
+        {
+            count_evaluations(c);
+            pool.parallel_for(c, [&](size_t pos, int worker)
+            {
+                gain[pos] = std::numeric_limits<double>::max();
+                if (!sel.available(pos))
+                    return;
+
+                // Total cost after adding the candidate (first round) or its change
+                const double *row = distance_row(valid_candidates[pos], bufs[worker]);
+                double total = 0.0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    const double d = row[i];
+                    if (sel.medoids.empty())
+                        total += quantities[i] * d;
+                    else if (d < nearest[i])
+                        total += quantities[i] * (d - nearest[i]);
+                }
+                gain[pos] = total;
+            });
+
+            int best = -1;
+            for (size_t pos = 0; pos < c; pos++)
+            {
+                if (sel.available(pos) && (best < 0 || gain[pos] < gain[best]))
+                    best = pos;
+            }
+            if (best < 0)
+                break;
+
+            select_candidate(sel, best);
+            const double *row = distance_row(valid_candidates[best], buf);
+            for (size_t i = 0; i < n; i++)
+                nearest[i] = std::min(nearest[i], row[i]);
+        }
+    }
+
+    // k-medoids++: the first medoid is drawn in proportion to resource
+    // quantity, the rest in proportion to quantity x D^2, where D is the
+    // distance from the candidate to its nearest chosen medoid.
+    void initialize_kmedoids_pp(Selection &sel, std::mt19937 &gen) const
+    {
+        const size_t c = valid_candidates.size();
+        std::vector<double> d_nearest(c, 1.0);
+        std::vector<double> weight(c);
+        RowBuffer buf;
+        for (size_t m = 0; m < sel.medoids.size(); m++)
+        {
+            const double *row = distance_row(sel.medoids[m], buf);
+            for (size_t pos = 0; pos < c; pos++)
+            {
+                const double d = row[valid_candidates[pos]];
+                d_nearest[pos] = (m == 0) ? d : std::min(d_nearest[pos], d);
+            }
+        }
+
+        while (sel.medoids.size() < k)
+        {
+            double total = 0.0;
+            for (size_t pos = 0; pos < c; pos++)
+            {
+                const double w = quantities[valid_candidates[pos]];
+                weight[pos] = sel.available(pos) ? std::max(w, 0.0) * d_nearest[pos] * d_nearest[pos] : 0.0;
+                total += weight[pos];
+            }
+
+            int chosen = -1;
+            if (total > 0)
+            {
+                std::discrete_distribution<int> dist(weight.begin(), weight.end());
+                chosen = dist(gen);
+            }
+            else
+            {
+                // Zero weights everywhere: fall back to any feasible candidate
+                for (size_t pos = 0; pos < c && chosen < 0; pos++)
+                {
+                    if (sel.available(pos))
+                        chosen = pos;
+                }
+            }
+            if (chosen < 0)
+                break;
+
+            const bool first = sel.medoids.empty();
+            select_candidate(sel, chosen);
+            const double *row = distance_row(valid_candidates[chosen], buf);
+            for (size_t pos = 0; pos < c; pos++)
+            {
+                const double d = row[valid_candidates[pos]];
+                d_nearest[pos] = first ? d : std::min(d_nearest[pos], d);
+            }
+        }
+    }
+
+    // LAB (linear approximative BUILD): each round runs the BUILD step on a
+    // fresh random sample of 10 + sqrt(N) feasible candidates, scored against
+    // a random sample of the same size of points.
+    void initialize_lab(Selection &sel, std::mt19937 &gen) const
+    {
+        const size_t n = points.size();
+        const size_t sample_size = 10 + static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(n))));
+        std::vector<int> feasible, sample_candidates, sample_points(n), visit;
+        for (size_t i = 0; i < n; i++)
+            sample_points[i] = i;
+
+        while (sel.medoids.size() < k)
+        {
+            feasible.clear();
+            for (size_t pos = 0; pos < valid_candidates.size(); pos++)
+            {
+                if (sel.available(pos))
+                    feasible.push_back(pos);
+            }
+            if (feasible.empty())
+                break;
+
+            // Partial Fisher-Yates shuffles pick both samples
+            const size_t cs = std::min(sample_size, feasible.size());
+            for (size_t i = 0; i < cs; i++)
+                std::swap(feasible[i], feasible[std::uniform_int_distribution<size_t>(i, feasible.size() - 1)(gen)]);
+            const size_t ps = std::min(sample_size, n);
+            for (size_t i = 0; i < ps; i++)
+                std::swap(sample_points[i], sample_points[std::uniform_int_distribution<size_t>(i, n - 1)(gen)]);
+
+            // Visit the sample by descending quantity, so a candidate's sum
+            // usually passes the best cost so far after a few points
+            visit.assign(sample_points.begin(), sample_points.begin() + ps);
+            std::sort(visit.begin(), visit.end(), [&](int a, int b)
+            {
+                return quantities[a] > quantities[b] || (quantities[a] == quantities[b] && a < b);
+            });
+            std::vector<double> nearest(ps, std::numeric_limits<double>::max());
+            for (size_t i = 0; i < ps; i++)
+            {
+                for (int m : sel.medoids)
+                    nearest[i] = std::min(nearest[i], get_distance_idx(visit[i], m));
+            }
+
+            int best = -1;
+            double best_cost = std::numeric_limits<double>::max();
+            for (size_t j = 0; j < cs; j++)
+            {
+                const int candidate_idx = valid_candidates[feasible[j]];
+                double cost = 0.0;
+                for (size_t i = 0; i < ps && cost < best_cost; i++)
+                {
+                    const int o = visit[i];
+                    cost += quantities[o] * std::min(nearest[i], get_distance_idx(o, candidate_idx));
+                }
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best = feasible[j];
+                }
+            }
+            // No sampled candidate reaches the sample at a finite cost
+            if (best < 0)
+                break;
+            select_candidate(sel, best);
+        }
+    }
+
+    // Resolves candidate rows into a CandidateBlock and releases the full
+    // distance source, so only |C| x N + |C| x |C| distances stay resident.
+    // False when a candidate has no rows left: the source matrix is released
+    // once the block holds its rows, so only subsets of the old candidates
+    // can be rebuilt without reloading the distances
+    bool build_candidate_block()
+    {
+        if (candidate_block.candidates == valid_candidates)
+            return true;
+        if (matrix_released)
+        {
+            for (int idx : valid_candidates)
+            {
+                if (candidate_block.position[idx] < 0)
+                {
+                    std::cerr << "Error: Candidate " << points[idx].id << " has no stored distances since --storage candidates"
+                              << " released the matrix; reload the distances to change the candidate set" << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        const size_t n = points.size();
+        const size_t c = valid_candidates.size();
+        CandidateBlock block;
+        block.candidates = valid_candidates;
+        block.position.assign(n, -1);
+        for (size_t i = 0; i < c; i++)
+            block.position[valid_candidates[i]] = i;
+        block.rows.resize(c * n);
+
+        // The old block, if any, still answers distance_row() while we copy
+        ThreadPool pool(num_threads);
+        std::vector<RowBuffer> bufs(pool.size());
+        pool.parallel_for(c, [&](size_t i, int worker)
+        {
+            const double *row = distance_row(valid_candidates[i], bufs[worker]);
+            std::copy(row, row + n, block.rows.begin() + i * n);
+        });
+
+        block.pairs.resize(c * c);
+        for (size_t b = 0; b < c; b++)
+        {
+            const double *row = block.row(b, n);
+            for (size_t a = 0; a < c; a++)
+                block.pairs[b * c + a] = row[valid_candidates[a]];
+        }
+
+        candidate_block = std::move(block);
+        if (!distance_matrix->empty())
+        {
+            distance_matrix = std::make_shared<DistanceMatrix>();
+            matrix_released = true;
+        }
+        if (road.use_count() == 1) // Cached rows are not shared with another optimizer
+        {
+            // A freed row is recomputed from the graph if it is needed again
+            for (int t : valid_candidates)
+            {
+                if (!road->graph.empty() && road->row_ready[t].load(std::memory_order_relaxed))
+                {
+                    road->row_ready[t].store(false, std::memory_order_relaxed);
+                    road->rows[t] = std::vector<double>();
+                }
+            }
+        }
+
+        log() << "Candidate distance storage: " << c << " x " << n << " rows ("
+                  << (c * n + c * c) * sizeof(double) / (1024 * 1024) << " MB)" << std::endl;
+        return true;
+    }
+
+    // Stages candidate rows of a memory-mapped matrix through a TileCache
+    // in tiles of swap batches, so the matrix itself need not fit in memory
+    void build_tile_cache()
+    {
+        if (tiles)
+            return;
+        if (!road->graph.empty() || !distance_matrix->mapped())
+        {
+            log() << "Tiled storage needs a binary distance matrix; reading rows directly" << std::endl;
+            return;
+        }
+        tiles = std::make_shared<TileCache>(distance_matrix, valid_candidates, swap_batch_size, tile_cache_mb << 20);
+        log() << "Tiled storage: " << tiles->tile_count() << " tiles of " << tiles->rows_per_tile() << " rows ("
+              << tile_cache_mb << " MB cache)" << std::endl;
+    }
+
+    // Queues the rows of the batch at batch_start and of the one after it
+    void prefetch_batches(const SwapProblem &problem, size_t batch_start) const
+    {
+        if (!problem.prefetch)
+            return;
+        const std::vector<int> &candidates = problem.candidates;
+        const size_t next = (batch_start + swap_batch_size < candidates.size()) ? batch_start + swap_batch_size : 0;
+        problem.prefetch(&candidates[batch_start], std::min(swap_batch_size, candidates.size() - batch_start));
+        problem.prefetch(&candidates[next], std::min(swap_batch_size, candidates.size() - next));
+    }
+
+    bool budget_spent() const
+    {
+        return budget && budget->exhausted();
+    }
+
+    void count_evaluations(uint64_t n) const
+    {
+        if (budget)
+            budget->count(n);
+    }
+
+    // Passes solutions that beat every earlier report to the progress callback
+    void report_progress(const std::vector<int> &medoids, double cost) const
+    {
+        if (!budget || !on_progress)
+            return;
+        std::lock_guard<std::mutex> lock(budget->progress_mutex);
+        if (cost >= budget->best_reported)
+            return;
+        budget->best_reported = cost;
+        on_progress(medoids, cost, budget->elapsed());
+    }
+
+    // The full problem: every point, served by any valid candidate
+    SwapProblem full_problem() const
+    {
+        SwapProblem problem;
+        problem.n = points.size();
+        problem.weights = quantities.data();
+        problem.candidates.resize(valid_candidates.size());
+        for (size_t pos = 0; pos < valid_candidates.size(); pos++)
+            problem.candidates[pos] = pos;
+        problem.row = [this](int pos, RowBuffer &buf) { return distance_row(valid_candidates[pos], buf); };
+        problem.geo = geo_only();
+        problem.reports = true;
+        if (tiles)
+            problem.prefetch = [cache = tiles](const int *positions, size_t count) { cache->prefetch(positions, count); };
+        if (capacitated())
+        {
+            problem.capacities.resize(valid_candidates.size());
+            for (size_t pos = 0; pos < valid_candidates.size(); pos++)
+                problem.capacities[pos] = center_capacity(valid_candidates[pos]);
+        }
+        return problem;
+    }
+
+    void build_cache(const SwapProblem &problem, const std::vector<int> &medoids, NearestCache &cache) const
+    {
+        RowBuffer buf;
+        build_cache(problem, medoids, cache, buf);
+    }
+
+    // medoids may be cache.medoids itself; buf is scratch for the medoid rows
+    void build_cache(const SwapProblem &problem, const std::vector<int> &medoids, NearestCache &cache, RowBuffer &buf) const
+    {
+        const size_t n = problem.n;
+        cache.medoids = medoids;
+        cache.nearest.assign(n, -1);
+        cache.d_nearest.assign(n, std::numeric_limits<double>::max());
+        cache.d_second.assign(n, std::numeric_limits<double>::max());
+
+        for (int j = 0; j < medoids.size(); j++)
+        {
+            const double *row = problem.row(candidate_position[medoids[j]], buf);
+            for (size_t i = 0; i < n; i++)
+            {
+                if (row[i] < cache.d_nearest[i])
+                {
+                    cache.d_second[i] = cache.d_nearest[i];
+                    cache.d_nearest[i] = row[i];
+                    cache.nearest[i] = j;
+                }
+                else if (row[i] < cache.d_second[i])
+                {
+                    cache.d_second[i] = row[i];
+                }
+            }
+        }
+
+        cache.total_cost = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            cache.total_cost += cache.d_nearest[i] * problem.weights[i];
+        }
+    }
+
+    // FastPAM1 delta: cost change of replacing each medoid slot with the
+    // candidate whose distance row is given, computed in a single O(N) pass.
+    void swap_deltas(const SwapProblem &problem, const NearestCache &cache, const double *candidate_row,
+                     std::vector<double> &delta) const
+    {
+        const size_t n = problem.n;
+        delta.assign(cache.medoids.size(), 0.0);
+        double shared = 0.0;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            const double w = problem.weights[i];
+            const double d = candidate_row[i];
+            const double dn = cache.d_nearest[i];
+            if (d < dn)
+            {
+                // Point moves to the candidate whichever medoid is removed
+                shared += w * (d - dn);
+            }
+            else
+            {
+                // Point only moves if its own medoid is removed
+                delta[cache.nearest[i]] += w * (std::min(d, cache.d_second[i]) - dn);
+            }
+        }
+
+        for (double &d : delta)
+        {
+            d += shared;
+        }
+    }
+
+    // Geo-only swap scoring. A point's term in a swap only depends on the
+    // candidate when the candidate is closer than its second-nearest medoid,
+    // so a candidate visits just the grid cells that can hold such points and
+    // the rest comes from per-slot removal losses. After a swap only the points
+    // near the medoids swapped in or out are recomputed.
+    struct GeoIndex
+    {
+        SpatialGrid grid;
+        std::vector<double> reach;        // Largest d_second in each cell
+        std::vector<double> removal_loss; // By slot: cost of dropping that medoid alone
+        std::vector<int> affected;        // geo_apply_swap scratch
+        std::vector<char> seen;           // By point; all zero between swaps
+    };
+
+    void geo_summarize(const SwapProblem &problem, const NearestCache &cache, GeoIndex &geo) const
+    {
+        geo.removal_loss.assign(cache.medoids.size(), 0.0);
+        for (size_t i = 0; i < problem.n; i++)
+            geo.removal_loss[cache.nearest[i]] += problem.weights[i] * (cache.d_second[i] - cache.d_nearest[i]);
+        geo.reach.assign(geo.grid.cells(), 0.0);
+        for (size_t c = 0; c < geo.grid.cells(); c++)
+        {
+            for (int m = geo.grid.cell_start[c]; m < geo.grid.cell_start[c + 1]; m++)
+                geo.reach[c] = std::max(geo.reach[c], cache.d_second[geo.grid.members[m]]);
+        }
+    }
+
+    // swap_deltas() for the candidate at pos without a full distance row
+    void geo_swap_deltas(const SwapProblem &problem, const NearestCache &cache, const GeoIndex &geo, int pos,
+                         std::vector<double> &delta) const
+    {
+        const int candidate = valid_candidates[pos];
+        delta = geo.removal_loss;
+        double shared = 0.0;
+        size_t computed = 0;
+        visit_near(geo.grid, candidate, [&](size_t c) { return geo.reach[c]; }, [&](int i)
+        {
+            computed++;
+            const double d = haversine_from(candidate, i);
+            const double ds = cache.d_second[i];
+            if (d >= ds)
+                return;
+            const double w = problem.weights[i];
+            const double dn = cache.d_nearest[i];
+            if (d < dn)
+            {
+                shared += w * (d - dn);
+                delta[cache.nearest[i]] -= w * (ds - dn);
+            }
+            else
+            {
+                delta[cache.nearest[i]] += w * (d - ds);
+            }
+        });
+        if (RunStats *s = stats.get())
+            s->haversine_fallbacks.fetch_add(computed, std::memory_order_relaxed);
+
+        for (double &d : delta)
+        {
+            d += shared;
+        }
+    }
+
+    // Puts medoid idx in slot, recomputing only the points it or the
+    // replaced medoid can be nearest or second-nearest to
+    void geo_apply_swap(const SwapProblem &problem, NearestCache &cache, GeoIndex &geo, int slot, int idx) const
+    {
+        std::vector<int> &affected = geo.affected;
+        std::vector<char> &seen = geo.seen;
+        affected.clear();
+        seen.resize(problem.n, 0);
+        auto mark = [&](int i)
+        {
+            if (!seen[i])
+            {
+                seen[i] = 1;
+                affected.push_back(i);
+            }
+        };
+        auto reach = [&](size_t c) { return geo.reach[c]; };
+        const int old_idx = cache.medoids[slot];
+        visit_near(geo.grid, old_idx, reach, [&](int i)
+        {
+            if (haversine_from(old_idx, i) <= cache.d_second[i])
+                mark(i);
+        });
+        visit_near(geo.grid, idx, reach, [&](int i)
+        {
+            if (haversine_from(idx, i) < cache.d_second[i])
+                mark(i);
+        });
+
+        cache.medoids[slot] = idx;
+        for (int i : affected)
+        {
+            seen[i] = 0;
+            cache.nearest[i] = -1;
+            cache.d_nearest[i] = std::numeric_limits<double>::max();
+            cache.d_second[i] = std::numeric_limits<double>::max();
+            for (int j = 0; j < cache.medoids.size(); j++)
+            {
+                const double d = haversine_from(cache.medoids[j], i);
+                if (d < cache.d_nearest[i])
+                {
+                    cache.d_second[i] = cache.d_nearest[i];
+                    cache.d_nearest[i] = d;
+                    cache.nearest[i] = j;
+                }
+                else if (d < cache.d_second[i])
+                {
+                    cache.d_second[i] = d;
+                }
+            }
+        }
+
+        cache.total_cost = 0.0;
+        for (size_t i = 0; i < problem.n; i++)
+        {
+            cache.total_cost += cache.d_nearest[i] * problem.weights[i];
+        }
+        geo_summarize(problem, cache, geo);
+    }
+
+    // Slot a candidate may replace: -1 for any slot, the one conflicting
+    // medoid's slot, or -2 when two or more medoids conflict with it
+    int feasible_slot(const std::vector<int> &medoids, int pos) const
+    {
+        int conflict_slot = -1;
+        if (!min_distance_active())
+            return conflict_slot;
+        for (int i = 0; i < medoids.size(); i++)
+        {
+            if (candidates_conflict(pos, candidate_position[medoids[i]]))
+            {
+                if (conflict_slot >= 0)
+                    return -2;
+                conflict_slot = i;
+            }
+        }
+        return conflict_slot;
+    }
+
+    // Capacitated assignment of the problem's points to medoids; bufs keeps
+    // the medoid rows alive while flow uses them
+    void solve_capacitated(const SwapProblem &problem, const std::vector<int> &medoids,
+                           std::vector<RowBuffer> &bufs, CapacitatedAssignment &flow) const
+    {
+        bufs.resize(medoids.size());
+        flow.reset(problem.n, problem.weights, medoids.size(), unserved_penalty);
+        for (int j = 0; j < medoids.size(); j++)
+        {
+            const int pos = candidate_position[medoids[j]];
+            flow.set_center(j, problem.row(pos, bufs[j]), problem.capacities[pos]);
+        }
+        flow.solve();
+    }
+
+    // Scratch of swap_search, sized on first use and reused by later passes,
+    // searches and CLARA samples, so the steady-state swap loop does not
+    // allocate. One workspace serves one search at a time.
+    struct SwapWorkspace
+    {
+        // Best improving swap of one candidate in the current batch
+        struct SwapChoice
+        {
+            double delta;
+            int slot;
+        };
+
+        // Capacitated swap whose lower bound beats the current cost
+        struct Promising
+        {
+            double bound;
+            int b;
+            int slot;
+            bool operator<(const Promising &o) const
+            {
+                return std::tie(bound, b, slot) < std::tie(o.bound, o.b, o.slot);
+            }
+        };
+
+        std::vector<RowBuffer> bufs;             // By worker
+        std::vector<std::vector<double>> deltas; // By worker
+        std::vector<char> is_medoid;             // By candidate position
+        std::vector<SwapChoice> choices;
+        std::vector<int> accepted; // Per iteration, when stats are enabled
+        RowBuffer cache_buf;       // build_cache() rows
+        GeoIndex geo;
+
+        std::vector<RowBuffer> medoid_bufs; // Keep the flow's medoid rows alive
+        CapacitatedAssignment flow;
+        std::vector<CapacitatedAssignment> trial; // By worker
+        std::vector<std::vector<Promising>> found;
+        std::vector<Promising> promising;
+        std::vector<double> exact;
+
+        // position maps a point index to its candidate position
+        void prepare(size_t workers, const std::vector<int> &medoids, const std::vector<int> &position, size_t candidates)
+        {
+            bufs.resize(std::max(bufs.size(), workers));
+            deltas.resize(std::max(deltas.size(), workers));
+            trial.resize(std::max(trial.size(), workers));
+            choices.resize(swap_batch_size);
+            found.resize(swap_batch_size);
+            accepted.clear();
+            accepted.reserve(max_swap_iterations);
+            is_medoid.assign(candidates, 0);
+            for (int m : medoids)
+                is_medoid[position[m]] = 1;
+        }
+    };
+
+    // Swap search under center capacities. The nearest-medoid cost of a set
+    // is a lower bound on its capacitated cost, so FastPAM deltas over the
+    // nearest cache screen every swap in O(N); only swaps whose bound beats
+    // the current capacitated cost are repaired exactly, best bound first,
+    // by warm-starting the flow with the replaced center's quantity rerouted.
+    int capacitated_swap_search(const SwapProblem &problem, NearestCache &cache, ThreadPool &pool, bool verbose,
+                                SwapWorkspace &ws)
+    {
+        ws.prepare(pool.size(), cache.medoids, candidate_position, valid_candidates.size());
+        std::vector<char> &is_medoid = ws.is_medoid;
+        std::vector<RowBuffer> &bufs = ws.bufs;
+        std::vector<std::vector<double>> &deltas = ws.deltas;
+        std::vector<CapacitatedAssignment> &trial = ws.trial;
+        std::vector<std::vector<SwapWorkspace::Promising>> &found = ws.found;
+        std::vector<SwapWorkspace::Promising> &promising = ws.promising;
+        std::vector<double> &exact = ws.exact;
+        std::vector<int> &accepted = ws.accepted;
+
+        CapacitatedAssignment &flow = ws.flow;
+        solve_capacitated(problem, cache.medoids, ws.medoid_bufs, flow);
+        double cost = flow.cost();
+        if (verbose)
+            log() << "Initial capacitated cost: " << cost << std::endl;
+        if (problem.reports)
+            report_progress(cache.medoids, cost);
+
+        const std::vector<int> &candidates = problem.candidates;
+        bool improved = true;
+        int iterations = 0;
+        RunStats *run_stats = stats.get();
+
+        while (improved && iterations < max_swap_iterations)
+        {
+            improved = false;
+            iterations++;
+            if (run_stats)
+                accepted.push_back(0);
+
+            for (size_t batch_start = 0; batch_start < candidates.size(); batch_start += swap_batch_size)
+            {
+                if (budget_spent())
+                {
+                    improved = false;
+                    break;
+                }
+                const size_t batch_count = std::min(swap_batch_size, candidates.size() - batch_start);
+                const double threshold = cost - 1e-12 * std::abs(cost);
+                prefetch_batches(problem, batch_start);
+
+                pool.parallel_for(batch_count, [&](size_t b, int worker)
+                {
+                    found[b].clear();
+                    const int pos = candidates[batch_start + b];
+                    if (is_medoid[pos])
+                        return;
+                    const int conflict_slot = feasible_slot(cache.medoids, pos);
+                    if (conflict_slot == -2)
+                    {
+                        if (run_stats)
+                            run_stats->swaps_pruned.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+
+                    std::vector<double> &delta = deltas[worker];
+                    swap_deltas(problem, cache, problem.row(pos, bufs[worker]), delta);
+                    count_evaluations(1);
+                    if (run_stats)
+                        run_stats->swaps_evaluated.fetch_add(conflict_slot >= 0 ? 1 : delta.size(), std::memory_order_relaxed);
+                    for (int i = 0; i < delta.size(); i++)
+                    {
+                        if (conflict_slot >= 0 && i != conflict_slot)
+                            continue;
+                        const double bound = cache.total_cost + delta[i];
+                        if (bound < threshold)
+                            found[b].push_back({bound, static_cast<int>(b), i});
+                    }
+                });
+
+                promising.clear();
+                for (size_t b = 0; b < batch_count; b++)
+                    promising.insert(promising.end(), found[b].begin(), found[b].end());
+                std::sort(promising.begin(), promising.end());
+
+                // Repair in bound order, one swap per worker at a time, until
+                // no remaining bound can beat the best exact cost (or the
+                // budget runs out; the best repair so far is still taken)
+                exact.assign(promising.size(), std::numeric_limits<double>::max());
+                int best = -1;
+                double best_cost = threshold;
+                for (size_t start = 0; start < promising.size() && promising[start].bound <= best_cost && !budget_spent();
+                     start += pool.size())
+                {
+                    const size_t count = std::min<size_t>(pool.size(), promising.size() - start);
+                    pool.parallel_for(count, [&](size_t g, int worker)
+                    {
+                        const SwapWorkspace::Promising &swap = promising[start + g];
+                        if (swap.bound > best_cost)
+                            return;
+                        const int pos = candidates[batch_start + swap.b];
+                        CapacitatedAssignment &repair = trial[worker];
+                        repair.copy_flow(flow);
+                        repair.set_center(swap.slot, problem.row(pos, bufs[worker]), problem.capacities[pos]);
+                        repair.solve();
+                        exact[start + g] = repair.cost();
+                    });
+                    for (size_t g = start; g < start + count; g++)
+                    {
+                        if (exact[g] < best_cost)
+                        {
+                            best_cost = exact[g];
+                            best = g;
+                        }
+                    }
+                }
+
+                if (best < 0)
+                    continue;
+
+                const SwapWorkspace::Promising &swap = promising[best];
+                const int pos = candidates[batch_start + swap.b];
+                is_medoid[candidate_position[cache.medoids[swap.slot]]] = 0;
+                is_medoid[pos] = 1;
+                cache.medoids[swap.slot] = valid_candidates[pos];
+                build_cache(problem, cache.medoids, cache, ws.cache_buf);
+                flow.set_center(swap.slot, problem.row(pos, ws.medoid_bufs[swap.slot]), problem.capacities[pos]);
+                flow.solve();
+                cost = flow.cost();
+                improved = true;
+                if (run_stats)
+                    accepted.back()++;
+                if (problem.reports)
+                    report_progress(cache.medoids, cost);
+            }
+
+            if (improved && verbose)
+            {
+                log() << "Iteration " << iterations << ": cost = " << cost << std::endl;
+            }
+        }
+        if (run_stats)
+            run_stats->add_search(std::vector<int>(accepted));
+        if (flow.unserved() > 0)
+            log() << "Warning: " << flow.unserved() << " units exceed the center capacities" << std::endl;
+
+        cache.total_cost = cost; // Callers report the capacitated cost
+        return iterations;
+    }
+
+    // FasterPAM over fixed-size candidate batches: every candidate in a batch
+    // is scored against the same cache (in parallel), then the best improving
+    // swap of the batch is applied before moving on. The batch size does not
+    // depend on the thread count, so neither do the results.
+    int swap_search(const SwapProblem &problem, NearestCache &cache, ThreadPool &pool, bool verbose)
+    {
+        SwapWorkspace ws;
+        return swap_search(problem, cache, pool, verbose, ws);
+    }
+
+    int swap_search(const SwapProblem &problem, NearestCache &cache, ThreadPool &pool, bool verbose, SwapWorkspace &ws)
+    {
+        if (!problem.capacities.empty())
+            return capacitated_swap_search(problem, cache, pool, verbose, ws);
+
+        ws.prepare(pool.size(), cache.medoids, candidate_position, valid_candidates.size());
+        std::vector<char> &is_medoid = ws.is_medoid;
+        std::vector<RowBuffer> &bufs = ws.bufs;
+        std::vector<std::vector<double>> &deltas = ws.deltas;
+        std::vector<SwapWorkspace::SwapChoice> &choices = ws.choices;
+        std::vector<int> &accepted = ws.accepted;
+
+        // Geo-only problems score swaps through a spatial grid; with a single
+        // medoid every point depends on the candidate, so there is nothing to prune.
+        // Geo problems always cover all points, so a built grid is reused.
+        const bool use_geo = problem.geo && cache.medoids.size() >= 2;
+        GeoIndex &geo = ws.geo;
+        if (use_geo)
+        {
+            if (geo.grid.members.size() != problem.n)
+            {
+                std::vector<int> all(problem.n);
+                std::iota(all.begin(), all.end(), 0);
+                geo.grid = build_grid(all, 32);
+            }
+            geo_summarize(problem, cache, geo);
+        }
+
+        const std::vector<int> &candidates = problem.candidates;
+        bool improved = true;
+        int iterations = 0;
+        RunStats *run_stats = stats.get();
+        if (problem.reports)
+            report_progress(cache.medoids, cache.total_cost);
+
+        while (improved && iterations < max_swap_iterations)
+        {
+            improved = false;
+            iterations++;
+            if (run_stats)
+                accepted.push_back(0);
+
+            for (size_t batch_start = 0; batch_start < candidates.size(); batch_start += swap_batch_size)
+            {
+                if (budget_spent())
+                {
+                    improved = false;
+                    break;
+                }
+                const size_t batch_count = std::min(swap_batch_size, candidates.size() - batch_start);
+                const double threshold = -1e-12 * std::abs(cache.total_cost);
+                if (!use_geo)
+                    prefetch_batches(problem, batch_start);
+
+                pool.parallel_for(batch_count, [&](size_t b, int worker)
+                {
+                    SwapWorkspace::SwapChoice &choice = choices[b];
+                    choice.slot = -1;
+                    choice.delta = threshold;
+
+                    const int pos = candidates[batch_start + b];
+                    if (is_medoid[pos])
+                    {
+                        return; // Already a medoid
+                    }
+
+                    // A swap is feasible only if the candidate conflicts with
+                    // no medoid other than the one it replaces
+                    const int conflict_slot = feasible_slot(cache.medoids, pos);
+                    if (conflict_slot == -2)
+                    {
+                        if (run_stats)
+                            run_stats->swaps_pruned.fetch_add(1, std::memory_order_relaxed);
+                        return; // Conflicts with two medoids; prune
+                    }
+
+                    std::vector<double> &delta = deltas[worker];
+                    if (use_geo)
+                        geo_swap_deltas(problem, cache, geo, pos, delta);
+                    else
+                        swap_deltas(problem, cache, problem.row(pos, bufs[worker]), delta);
+                    count_evaluations(1);
+                    if (run_stats)
+                        run_stats->swaps_evaluated.fetch_add(conflict_slot >= 0 ? 1 : delta.size(), std::memory_order_relaxed);
+                    for (int i = 0; i < delta.size(); i++)
+                    {
+                        if (conflict_slot >= 0 && i != conflict_slot)
+                            continue;
+                        if (delta[i] < choice.delta)
+                        {
+                            choice.delta = delta[i];
+                            choice.slot = i;
+                        }
+                    }
+                });
+
+                // Reduce in candidate order; ties go to the earliest candidate
+                int best_b = -1;
+                for (size_t b = 0; b < batch_count; b++)
+                {
+                    if (choices[b].slot >= 0 && (best_b < 0 || choices[b].delta < choices[best_b].delta))
+                        best_b = b;
+                }
+
+                if (best_b < 0)
+                    continue;
+
+                const int pos = candidates[batch_start + best_b];
+                const int slot = choices[best_b].slot;
+                is_medoid[candidate_position[cache.medoids[slot]]] = 0;
+                is_medoid[pos] = 1;
+                if (use_geo)
+                {
+                    geo_apply_swap(problem, cache, geo, slot, valid_candidates[pos]);
+                }
+                else
+                {
+                    cache.medoids[slot] = valid_candidates[pos];
+                    build_cache(problem, cache.medoids, cache, ws.cache_buf);
+                }
+                improved = true;
+                if (run_stats)
+                    accepted.back()++;
+                if (problem.reports)
+                    report_progress(cache.medoids, cache.total_cost);
+            }
+
+            if (improved && verbose)
+            {
+                log() << "Iteration " << iterations << ": cost = " << cache.total_cost << std::endl;
+            }
+        }
+        if (run_stats)
+            run_stats->add_search(std::vector<int>(accepted));
+        return iterations;
+    }
+
+    std::pair<std::vector<int>, double> optimize()
+    {
+        // The budget covers the whole call, including candidate preparation
+        budget.reset();
+        if (time_budget > 0 || max_evaluations > 0 || on_progress)
+        {
+            budget = std::make_shared<SearchBudget>();
+            if (time_budget > 0)
+                budget->deadline = budget->start + std::chrono::duration_cast<SearchBudget::Clock::duration>(
+                                                       std::chrono::duration<double>(time_budget));
+            budget->max_evaluations = max_evaluations;
+        }
+        auto result = run_optimize();
+        if (budget && budget->spent)
+            log() << "Search budget spent after " << budget->elapsed() << " s" << std::endl;
+        budget.reset();
+        return result;
+    }
+
+    std::pair<std::vector<int>, double> run_optimize()
+    {
+        {
+            PhaseTimer timer(stats.get(), "filter");
+            filter_candidates();
+        }
+
+        if (valid_candidates.size() < k)
+        {
+            log() << "Error: Not enough valid candidates (" << valid_candidates.size() << ") for k=" << k << std::endl;
+            return {{}, std::numeric_limits<double>::max()};
+        }
+
+        {
+            // CLARA only ever touches sampled candidates, and distributed
+            // candidates are scored remotely, so both skip the
+            // candidate-wide precomputation and keep memory bounded
+            PhaseTimer timer(stats.get(), "prepare");
+            if (algorithm != Algorithm::Clara && !pass_scorer.score)
+            {
+                // Medoids are always candidates, so these are the only rows needed
+                prepare_graph_rows(valid_candidates);
+                if (storage_mode == StorageMode::Candidates && !build_candidate_block())
+                {
+                    return {{}, std::numeric_limits<double>::max()};
+                }
+                else if (storage_mode == StorageMode::Tiled)
+                {
+                    build_tile_cache();
+                }
+            }
+            build_conflict_graph();
+        }
+
+        log() << "Random seed: " << seed << std::endl;
+        if (!initial_medoid_ids.empty())
+        {
+            Selection warm = start_selection();
+            seed_initial_medoids(warm);
+            log() << "Warm start from " << warm.medoids.size() << " of " << initial_medoid_ids.size()
+                  << " initial medoids" << std::endl;
+        }
+
+        ThreadPool pool(num_threads);
+        if (pass_scorer.score)
+            return optimize_distributed(pool);
+        switch (algorithm)
+        {
+        case Algorithm::Clara:
+            return optimize_clara(pool);
+        case Algorithm::Clarans:
+            return optimize_clarans(pool);
+        default:
+            return optimize_pam(pool);
+        }
+    }
+
+    std::pair<std::vector<int>, double> optimize_pam(ThreadPool &pool)
+    {
+        if (num_restarts > 1)
+        {
+            return optimize_restarts(pool);
+        }
+
+        SwapProblem problem = full_problem();
+        NearestCache cache;
+        {
+            PhaseTimer timer(stats.get(), "init");
+            build_cache(problem, initialize_medoids(rng, pool), cache);
+        }
+
+        log() << "Initial cost: " << cache.total_cost << std::endl;
+
+        PhaseTimer timer(stats.get(), "swap");
+        int iterations = swap_search(problem, cache, pool, true);
+
+        if (budget_spent())
+            log() << "Stopped after " << iterations << " iterations" << std::endl;
+        else
+            log() << "Converged after " << iterations << " iterations" << std::endl;
+        return {cache.medoids, cache.total_cost};
+    }
+
+    // Wall-clock seconds of each optimize() phase, for the bench subcommand
+    struct PhaseTimes
+    {
+        double filter = 0, init = 0, swap = 0, cost = 0, output = 0;
+        size_t candidates = 0;
+        int iterations = 0;
+        double total_cost = 0;
+    };
+
+    // optimize_pam() split into timed phases; cost times one
+    // calculate_total_cost() and output formats the text results
+    PhaseTimes profile_optimize()
+    {
+        using Clock = std::chrono::steady_clock;
+        auto seconds = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double>(b - a).count(); };
+        PhaseTimes times;
+
+        auto t0 = Clock::now();
+        filter_candidates();
+        times.candidates = valid_candidates.size();
+        if (valid_candidates.size() < k)
+            return times;
+        prepare_graph_rows(valid_candidates);
+        if (storage_mode == StorageMode::Candidates && !build_candidate_block())
+            return times;
+        else if (storage_mode == StorageMode::Tiled)
+            build_tile_cache();
+        build_conflict_graph();
+
+        auto t1 = Clock::now();
+        ThreadPool pool(num_threads);
+        SwapProblem problem = full_problem();
+        NearestCache cache;
+        build_cache(problem, initialize_medoids(rng, pool), cache);
+
+        auto t2 = Clock::now();
+        times.iterations = swap_search(problem, cache, pool, false);
+
+        auto t3 = Clock::now();
+        times.total_cost = calculate_total_cost(cache.medoids);
+
+        auto t4 = Clock::now();
+        static NullBuffer null_buffer;
+        std::ostream sink(&null_buffer);
+        print_results(cache.medoids, cache.total_cost, OutputFormat::Text, sink);
+        auto t5 = Clock::now();
+
+        times.filter = seconds(t0, t1);
+        times.init = seconds(t1, t2);
+        times.swap = seconds(t2, t3);
+        times.cost = seconds(t3, t4);
+        times.output = seconds(t4, t5);
+        return times;
+    }
+
+    // Independent PAM runs, one per pool worker at a time. Restart r draws its
+    // initial medoids from a generator seeded with (seed, r), and all runs share
+    // the loaded points, distances and candidate data read-only, so the best
+    // solution depends only on the seed and not on the thread count.
+    std::pair<std::vector<int>, double> optimize_restarts(ThreadPool &pool)
+    {
+        PhaseTimer timer(stats.get(), "restarts");
+        const SwapProblem problem = full_problem();
+        std::vector<NearestCache> results(num_restarts);
+        std::vector<int> iterations(num_restarts);
+        std::vector<SwapWorkspace> workspaces(pool.size());
+
+        auto run = [&](size_t r, int worker, ThreadPool &search_pool)
+        {
+            // Restarts not begun when the budget runs out are skipped
+            if (r > 0 && budget_spent())
+            {
+                results[r].total_cost = std::numeric_limits<double>::max();
+                iterations[r] = -1;
+                return;
+            }
+            std::seed_seq seq{static_cast<unsigned>(seed), static_cast<unsigned>(seed >> 32), static_cast<unsigned>(r)};
+            std::mt19937 gen(seq);
+            SwapWorkspace &ws = workspaces[worker];
+            build_cache(problem, initialize_medoids(gen, search_pool), results[r], ws.cache_buf);
+            iterations[r] = swap_search(problem, results[r], search_pool, false, ws);
+        };
+
+        // Concurrent restarts would split an evaluation budget by timing, so
+        // they then run in order, each search using the whole pool
+        if (budget && budget->max_evaluations)
+        {
+            for (int r = 0; r < num_restarts; r++)
+                run(r, 0, pool);
+        }
+        else
+        {
+            pool.parallel_for(num_restarts, [&](size_t r, int worker)
+            {
+                ThreadPool inline_pool(1);
+                run(r, worker, inline_pool);
+            });
+        }
+
+        int best = 0;
+        for (int r = 0; r < num_restarts; r++)
+        {
+            if (iterations[r] < 0)
+            {
+                log() << "Restart " << r + 1 << ": skipped" << std::endl;
+                continue;
+            }
+            log() << "Restart " << r + 1 << ": cost = " << results[r].total_cost
+                      << " after " << iterations[r] << " iterations" << std::endl;
+            if (results[r].total_cost < results[best].total_cost)
+                best = r;
+        }
+        log() << "Best of " << num_restarts << " restarts: " << best + 1 << std::endl;
+        return {results[best].medoids, results[best].total_cost};
+    }
+
+    // Distances from the points in subset to to_idx, without building full rows
+    void gather_row(int to_idx, const std::vector<int> &subset, double *out) const
+    {
+        const bool has_rows = (!candidate_block.empty() && candidate_block.position[to_idx] >= 0) ||
+                              !distance_matrix->empty() || !road->graph.empty();
+        if (!has_rows)
+        {
+            haversine_batch(to_idx, subset.data(), subset.size(), out);
+            return;
+        }
+        for (size_t i = 0; i < subset.size(); i++)
+            out[i] = get_distance_idx(subset[i], to_idx);
+    }
+
+    // CLARA: run the swap search on repeated random point samples, with the
+    // sampled candidates plus the best medoids so far as possible medoids,
+    // and score each result on the full point set. Memory per sample is
+    // bounded by sample_size^2 distances.
+    std::pair<std::vector<int>, double> optimize_clara(ThreadPool &pool)
+    {
+        PhaseTimer timer(stats.get(), "clara");
+        const size_t n = points.size();
+        const size_t s = std::min(n, (sample_size > 0) ? static_cast<size_t>(sample_size) : static_cast<size_t>(40 + 2 * k));
+        log() << "CLARA: " << num_samples << " samples of " << s << " points" << std::endl;
+
+        std::vector<int> order(n);
+        for (size_t i = 0; i < n; i++)
+            order[i] = i;
+        std::vector<int> local_index(valid_candidates.size(), -1);
+        build_cost_order();
+
+        std::vector<int> best_medoids;
+        double best_cost = std::numeric_limits<double>::max();
+
+        // Reused by every sample
+        std::vector<int> subset(s);
+        std::vector<double> sample_weights(s);
+        std::vector<double> block;
+        NearestCache cache;
+        SwapWorkspace ws;
+        CostScratch scratch;
+
+        // A complete warm start is the first incumbent
+        Selection warm = start_selection();
+        seed_initial_medoids(warm);
+        if (warm.medoids.size() == k)
+        {
+            best_medoids = warm.medoids;
+            best_cost = calculate_total_cost(best_medoids);
+            report_progress(best_medoids, best_cost);
+        }
+
+        for (int sample = 0; sample < num_samples; sample++)
+        {
+            if (!best_medoids.empty() && budget_spent())
+            {
+                log() << "Stopped after " << sample << " samples" << std::endl;
+                break;
+            }
+
+            // Uniform sample without replacement (partial Fisher-Yates)
+            for (size_t i = 0; i < s; i++)
+                std::swap(order[i], order[std::uniform_int_distribution<size_t>(i, n - 1)(rng)]);
+            std::copy(order.begin(), order.begin() + s, subset.begin());
+
+            // Candidate set: sampled candidates, the incumbent medoids, and
+            // random extra candidates if the sample holds fewer than k
+            SwapProblem problem;
+            for (int i : subset)
+            {
+                if (candidate_position[i] >= 0)
+                    problem.candidates.push_back(candidate_position[i]);
+            }
+            for (int m : best_medoids)
+            {
+                if (std::find(problem.candidates.begin(), problem.candidates.end(), candidate_position[m]) == problem.candidates.end())
+                    problem.candidates.push_back(candidate_position[m]);
+            }
+            while (problem.candidates.size() < std::min<size_t>(2 * k, valid_candidates.size()))
+            {
+                int pos = std::uniform_int_distribution<int>(0, valid_candidates.size() - 1)(rng);
+                if (std::find(problem.candidates.begin(), problem.candidates.end(), pos) == problem.candidates.end())
+                    problem.candidates.push_back(pos);
+            }
+            std::sort(problem.candidates.begin(), problem.candidates.end());
+
+            for (size_t i = 0; i < s; i++)
+                sample_weights[i] = quantities[subset[i]];
+
+            block.resize(problem.candidates.size() * s);
+            pool.parallel_for(problem.candidates.size(), [&](size_t j, int)
+            {
+                gather_row(valid_candidates[problem.candidates[j]], subset, &block[j * s]);
+            });
+            for (size_t j = 0; j < problem.candidates.size(); j++)
+                local_index[problem.candidates[j]] = j;
+
+            problem.n = s;
+            problem.weights = sample_weights.data();
+            problem.row = [&](int pos, RowBuffer &) { return &block[static_cast<size_t>(local_index[pos]) * s]; };
+
+            // Start from the incumbent, or a random feasible set
+            std::vector<int> initial = best_medoids;
+            if (initial.empty())
+            {
+                Selection sel = start_selection();
+                std::vector<int> shuffled = problem.candidates;
+                std::shuffle(shuffled.begin(), shuffled.end(), rng);
+                for (int pos : shuffled)
+                {
+                    if (sel.medoids.size() < k && sel.available(pos))
+                        select_candidate(sel, pos);
+                }
+                initial = sel.medoids;
+            }
+
+            build_cache(problem, initial, cache, ws.cache_buf);
+            swap_search(problem, cache, pool, false, ws);
+
+            // Most samples lose to the incumbent, so scoring stops as soon as
+            // the running sum reaches its cost
+            double cost = bounded_total_cost(cache.medoids, best_cost, scratch);
+            if (cost < best_cost)
+                log() << "Sample " << sample + 1 << ": cost = " << cost << std::endl;
+            else
+                log() << "Sample " << sample + 1 << ": cost >= " << best_cost << std::endl;
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_medoids = cache.medoids;
+                report_progress(best_medoids, best_cost);
+            }
+
+            for (int pos : problem.candidates)
+                local_index[pos] = -1;
+        }
+
+        if (best_medoids.size() < k)
+        {
+            log() << "Warning: Cannot find " << k << " medoids satisfying distance constraint" << std::endl;
+        }
+        return {best_medoids, best_cost};
+    }
+
+    // CLARANS: randomized local search on the full point set. A random
+    // feasible (slot, candidate) swap is scored in O(N) and taken if it
+    // improves; a local search ends after max_neighbors failed tries in a row.
+    std::pair<std::vector<int>, double> optimize_clarans(ThreadPool &pool)
+    {
+        PhaseTimer timer(stats.get(), "clarans");
+        RunStats *run_stats = stats.get();
+        SwapProblem problem = full_problem();
+        const size_t c = valid_candidates.size();
+        const long neighbors = (max_neighbors > 0)
+                                   ? max_neighbors
+                                   : std::max(250L, static_cast<long>(0.0125 * k * (c - std::min<size_t>(k, c))));
+        log() << "CLARANS: " << num_samples << " local searches, " << neighbors << " neighbors each" << std::endl;
+
+        std::vector<int> best_medoids;
+        double best_cost = std::numeric_limits<double>::max();
+        RowBuffer buf;
+        std::vector<double> delta;
+        NearestCache cache;
+        std::vector<char> is_medoid(c);
+
+        for (int local = 0; local < num_samples; local++)
+        {
+            if (local > 0 && budget_spent())
+            {
+                log() << "Stopped after " << local << " local searches" << std::endl;
+                break;
+            }
+            build_cache(problem, initialize_medoids(rng, pool), cache, buf);
+            if (cache.medoids.empty())
+                break;
+            report_progress(cache.medoids, cache.total_cost);
+
+            std::fill(is_medoid.begin(), is_medoid.end(), 0);
+            for (int m : cache.medoids)
+                is_medoid[candidate_position[m]] = 1;
+            int accepted = 0;
+
+            for (long tries = 0; tries < neighbors && !budget_spent(); tries++)
+            {
+                const int slot = std::uniform_int_distribution<int>(0, cache.medoids.size() - 1)(rng);
+                const int pos = std::uniform_int_distribution<int>(0, c - 1)(rng);
+                if (is_medoid[pos])
+                    continue;
+                const int conflict_slot = feasible_slot(cache.medoids, pos);
+                if (conflict_slot == -2 || (conflict_slot >= 0 && conflict_slot != slot))
+                {
+                    if (run_stats)
+                        run_stats->swaps_pruned.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                swap_deltas(problem, cache, problem.row(pos, buf), delta);
+                count_evaluations(1);
+                if (run_stats)
+                    run_stats->swaps_evaluated.fetch_add(1, std::memory_order_relaxed);
+                if (delta[slot] < -1e-12 * std::abs(cache.total_cost))
+                {
+                    accepted++;
+                    is_medoid[candidate_position[cache.medoids[slot]]] = 0;
+                    is_medoid[pos] = 1;
+                    cache.medoids[slot] = valid_candidates[pos];
+                    build_cache(problem, cache.medoids, cache, buf);
+                    report_progress(cache.medoids, cache.total_cost);
+                    tries = -1; // Restart the neighbor count
+                }
+            }
+
+            if (run_stats)
+                run_stats->add_search({accepted});
+            log() << "Local search " << local + 1 << ": cost = " << cache.total_cost << std::endl;
+            if (cache.total_cost < best_cost)
+            {
+                best_cost = cache.total_cost;
+                best_medoids = cache.medoids;
+            }
+        }
+        return {best_medoids, best_cost};
+    }
+
+    // Distributed PAM. Workers each hold a contiguous share of the
+    // candidates; every pass sends them the k medoids, each returns its best
+    // swap, and the best one overall is applied. One swap per pass over all
+    // candidates, so results do not depend on the worker or thread count,
+    // but can differ from the batched local search.
+    std::pair<std::vector<int>, double> optimize_distributed(ThreadPool &pool)
+    {
+        PhaseTimer timer(stats.get(), "distributed");
+        const std::pair<std::vector<int>, double> failed{{}, std::numeric_limits<double>::max()};
+        if (!pass_scorer.begin(valid_candidates.size()))
+            return failed;
+
+        std::vector<int> medoids;
+        {
+            PhaseTimer init_timer(stats.get(), "init");
+            medoids = initialize_medoids(rng, pool);
+        }
+
+        double cost = 0.0;
+        int swaps = 0;
+        for (;;)
+        {
+            SwapProposal best;
+            if (!pass_scorer.score(medoids, best))
+                return failed;
+            if (best.candidate >= 0 && (best.candidate >= points.size() || candidate_position[best.candidate] < 0 ||
+                                        best.slot < 0 || best.slot >= medoids.size()))
+            {
+                std::cerr << "Error: Worker proposed an invalid swap" << std::endl;
+                return failed;
+            }
+            cost = best.cost;
+            count_evaluations(valid_candidates.size());
+            if (swaps == 0)
+                log() << "Initial cost: " << cost << std::endl;
+            report_progress(medoids, cost);
+            if (best.candidate < 0 || !(best.delta < -1e-12 * std::abs(cost)))
+                break;
+
+            medoids[best.slot] = best.candidate;
+            cost += best.delta;
+            swaps++;
+            log() << "Pass " << swaps << ": cost = " << cost << std::endl;
+            if (budget_spent())
+            {
+                report_progress(medoids, cost);
+                break;
+            }
+        }
+
+        if (budget_spent())
+            log() << "Stopped after " << swaps << " swaps" << std::endl;
+        else
+            log() << "Converged after " << swaps << " swaps" << std::endl;
+        return {medoids, cost};
+    }
+
+    // Worker side of a distributed solve
+    struct Partition
+    {
+        size_t first = 0, last = 0; // Positions in valid_candidates of the share
+        SwapProblem problem;
+        NearestCache cache;
+        SwapWorkspace ws;
+    };
+
+    // Takes share part of num_parts of the valid candidates and loads the
+    // distances from road_file ("none" for Haversine). Only the share's rows
+    // and the medoid rows are read: binary matrices are memory-mapped and
+    // road graphs compute rows on demand. A dense CSV matrix would have to be
+    // parsed whole, so it is refused. No conflict graph is built, since it
+    // would need every candidate pair; feasibility tests the medoid
+    // distances directly.
+    void begin_partition(Partition &partition, size_t part, size_t num_parts, const std::string &road_file)
+    {
+        filter_candidates();
+        const size_t c = valid_candidates.size();
+        partition.first = c * part / num_parts;
+        partition.last = c * (part + 1) / num_parts;
+        const std::vector<int> share(valid_candidates.begin() + partition.first, valid_candidates.begin() + partition.last);
+        if (road_file != "none" && is_dense_csv_matrix(road_file))
+            throw std::runtime_error(road_file + " is a dense CSV matrix; convert it to a binary matrix for workers");
+        if (road_file != "none" && !load_distances(road_file))
+            throw std::runtime_error("cannot load road distances from " + road_file);
+        prepare_graph_rows(share);
+        if (storage_mode == StorageMode::Tiled)
+            build_tile_cache();
+
+        const size_t first = partition.first, last = partition.last;
+        partition.problem = full_problem();
+        partition.problem.reports = false;
+        partition.problem.capacities.clear();
+        partition.problem.candidates.resize(last - first);
+        std::iota(partition.problem.candidates.begin(), partition.problem.candidates.end(), static_cast<int>(first));
+        log() << "Partition " << part + 1 << " of " << num_parts << ": candidates " << first << " to " << last << std::endl;
+    }
+
+    // Best improving swap among the partition's candidates for medoids
+    // (point indices, all valid candidates). Ties go to the earliest
+    // candidate, as in swap_search().
+    SwapProposal score_partition(Partition &partition, const std::vector<int> &medoids, ThreadPool &pool)
+    {
+        for (int m : medoids)
+        {
+            if (m < 0 || m >= points.size() || candidate_position[m] < 0)
+                throw std::runtime_error("medoid " + std::to_string(m) + " is not a valid candidate");
+        }
+
+        const SwapProblem &problem = partition.problem;
+        NearestCache &cache = partition.cache;
+        SwapWorkspace &ws = partition.ws;
+        build_cache(problem, medoids, cache, ws.cache_buf);
+        ws.prepare(pool.size(), cache.medoids, candidate_position, valid_candidates.size());
+        const bool use_geo = problem.geo && cache.medoids.size() >= 2;
+        if (use_geo)
+        {
+            if (ws.geo.grid.members.size() != problem.n)
+            {
+                std::vector<int> all(problem.n);
+                std::iota(all.begin(), all.end(), 0);
+                ws.geo.grid = build_grid(all, 32);
+            }
+            geo_summarize(problem, cache, ws.geo);
+        }
+
+        SwapProposal best;
+        best.cost = cache.total_cost;
+        best.delta = -1e-12 * std::abs(cache.total_cost);
+        const std::vector<int> &candidates = problem.candidates;
+        for (size_t batch_start = 0; batch_start < candidates.size(); batch_start += swap_batch_size)
+        {
+            const size_t batch_count = std::min(swap_batch_size, candidates.size() - batch_start);
+            if (!use_geo)
+                prefetch_batches(problem, batch_start);
+            pool.parallel_for(batch_count, [&](size_t b, int worker)
+            {
+                SwapWorkspace::SwapChoice &choice = ws.choices[b];
+                choice.slot = -1;
+                choice.delta = best.delta;
+                const int pos = candidates[batch_start + b];
+                const int conflict_slot = ws.is_medoid[pos] ? -2 : feasible_slot(cache.medoids, pos);
+                if (conflict_slot == -2)
+                    return;
+
+                std::vector<double> &delta = ws.deltas[worker];
+                if (use_geo)
+                    geo_swap_deltas(problem, cache, ws.geo, pos, delta);
+                else
+                    swap_deltas(problem, cache, problem.row(pos, ws.bufs[worker]), delta);
+                for (int i = 0; i < delta.size(); i++)
+                {
+                    if ((conflict_slot < 0 || i == conflict_slot) && delta[i] < choice.delta)
+                    {
+                        choice.delta = delta[i];
+                        choice.slot = i;
+                    }
+                }
+            });
+
+            for (size_t b = 0; b < batch_count; b++)
+            {
+                if (ws.choices[b].slot >= 0 && ws.choices[b].delta < best.delta)
+                {
+                    best.delta = ws.choices[b].delta;
+                    best.slot = ws.choices[b].slot;
+                    best.candidate = valid_candidates[candidates[batch_start + b]];
+                }
+            }
+        }
+        return best;
+    }
+
+    // Starts tracking medoids (point indices from optimize()) for incremental
+    // updates. Each later change costs O(k); a swap refinement runs only when
+    // the cost per unit quantity drifts by more than refine_threshold
+    // (relative) from its value at the last refinement.
+    bool track_solution(const std::vector<int> &medoids, double refine_threshold = 0.02)
+    {
+        if (candidate_position.empty())
+        {
+            filter_candidates();
+            build_conflict_graph();
+        }
+        for (int m : medoids)
+        {
+            if (m < 0 || m >= points.size() || candidate_position[m] < 0)
+            {
+                std::cerr << "Error: Tracked medoids must be valid candidates" << std::endl;
+                return false;
+            }
+        }
+
+        live = LiveState();
+        live.weights = quantities;
+        live.refine_threshold = refine_threshold;
+        for (double w : live.weights)
+            live.total_weight += w;
+        build_cache(live_problem(), medoids, live.cache);
+        live.reference_cost = live_cost_per_unit();
+        return true;
+    }
+
+    const std::vector<int> &live_medoids() const { return live.cache.medoids; }
+    double live_cost() const { return live.cache.total_cost; }
+
+    // Adds a demand point; false if its ID is already in use
+    bool add_point(const Point &p)
+    {
+        if (live.weights.empty() || id_to_index.count(p.id) || live.inserted_slot.count(p.id))
+            return false;
+
+        const int slot = live.weights.size();
+        live.inserted_slot[p.id] = slot;
+        live.lat_rad.push_back(p.lat * M_PI / 180.0);
+        live.lon_rad.push_back(p.lon * M_PI / 180.0);
+        live.cos_lat.push_back(std::cos(live.lat_rad.back()));
+        live.weights.push_back(0.0);
+
+        // Nearest and second-nearest of the k medoids
+        NearestCache &cache = live.cache;
+        cache.nearest.push_back(-1);
+        cache.d_nearest.push_back(std::numeric_limits<double>::max());
+        cache.d_second.push_back(std::numeric_limits<double>::max());
+        for (int j = 0; j < cache.medoids.size(); j++)
+        {
+            const double d = live_distance(slot, cache.medoids[j]);
+            if (d < cache.d_nearest[slot])
+            {
+                cache.d_second[slot] = cache.d_nearest[slot];
+                cache.d_nearest[slot] = d;
+                cache.nearest[slot] = j;
+            }
+            else if (d < cache.d_second[slot])
+            {
+                cache.d_second[slot] = d;
+            }
+        }
+        return update_slot_weight(slot, p.resource_quantity);
+    }
+
+    // Removes a point's demand; loaded points stay available as centers
+    bool remove_point(int id)
+    {
+        const int slot = live_slot(id);
+        if (slot < 0)
+            return false;
+        update_slot_weight(slot, 0.0);
+        live.inserted_slot.erase(id);
+        return true;
+    }
+
+    bool update_quantity(int id, double quantity)
+    {
+        const int slot = live_slot(id);
+        return slot >= 0 && update_slot_weight(slot, quantity);
+    }
+
+    // Local swap search from the tracked medoids over the current demand
+    void refine_live_solution()
+    {
+        const SwapProblem problem = live_problem();
+        build_cache(problem, live.cache.medoids, live.cache); // Also drops accumulated rounding
+        ThreadPool pool(num_threads);
+        const double before = live.cache.total_cost;
+        swap_search(problem, live.cache, pool, false);
+        live.reference_cost = live_cost_per_unit();
+        log() << "Refined live solution: cost " << before << " -> " << live.cache.total_cost << std::endl;
+    }
+
+    int live_slot(int id) const
+    {
+        if (live.weights.empty())
+            return -1; // Not tracking a solution
+        auto it = id_to_index.find(id);
+        if (it != id_to_index.end())
+            return it->second;
+        auto inserted = live.inserted_slot.find(id);
+        return (inserted != live.inserted_slot.end()) ? inserted->second : -1;
+    }
+
+    bool update_slot_weight(int slot, double quantity)
+    {
+        const double change = quantity - live.weights[slot];
+        live.weights[slot] = quantity;
+        live.total_weight += change;
+        live.cache.total_cost += change * live.cache.d_nearest[slot];
+        if (slot < points.size())
+        {
+            quantities.write()[slot] = quantity;
+            points.write()[slot].resource_quantity = quantity;
+        }
+
+        const double per_unit = live_cost_per_unit();
+        if (std::abs(per_unit - live.reference_cost) > live.refine_threshold * live.reference_cost)
+            refine_live_solution();
+        return true;
+    }
+
+    double live_cost_per_unit() const
+    {
+        return (live.total_weight > 0) ? live.cache.total_cost / live.total_weight : 0.0;
+    }
+
+    // Distance from a slot to a loaded point
+    double live_distance(int slot, int to_idx) const
+    {
+        if (slot < points.size())
+            return get_distance_idx(slot, to_idx);
+
+        const size_t e = slot - points.size();
+        const double R = 6371000;
+        double sdlat = sin((lat_rad[to_idx] - live.lat_rad[e]) / 2);
+        double sdlon = sin((lon_rad[to_idx] - live.lon_rad[e]) / 2);
+        double a = sdlat * sdlat + live.cos_lat[e] * cos_lat[to_idx] * sdlon * sdlon;
+        return R * 2 * atan2(sqrt(a), sqrt(1 - a));
+    }
+
+    // The full problem over the live slots
+    SwapProblem live_problem() const
+    {
+        SwapProblem problem = full_problem();
+        const size_t n = points.size();
+        problem.capacities.clear(); // Live updates keep nearest-center assignment
+        problem.geo = false;
+        problem.n = live.weights.size();
+        problem.weights = live.weights.data();
+        if (problem.n > n)
+        {
+            problem.row = [this, n](int pos, RowBuffer &buf)
+            {
+                const int to_idx = valid_candidates[pos];
+                const double *row = distance_row(to_idx, buf);
+                if (row != buf.values.data())
+                    buf.values.assign(row, row + n);
+                buf.values.resize(live.weights.size());
+                for (size_t slot = n; slot < buf.values.size(); slot++)
+                    buf.values[slot] = live_distance(slot, to_idx);
+                return static_cast<const double *>(buf.values.data());
+            };
+        }
+        return problem;
+    }
+
+    // Runs every scenario against the loaded data. Scenario optimizers share
+    // the distance source and road-row cache, rows for the union of their
+    // candidates are computed once up front, and scenarios run concurrently
+    // on --threads with the same seed a standalone run would use.
+    std::vector<std::pair<std::vector<int>, double>> optimize_batch(const std::vector<Scenario> &scenarios)
+    {
+        std::vector<KMedoidsOptimizer> runs;
+        runs.reserve(scenarios.size());
+        std::vector<char> needed(points.size(), 0);
+        for (const Scenario &scenario : scenarios)
+        {
+            runs.push_back(*this);
+            KMedoidsOptimizer &run = runs.back();
+            run.set_constraints(scenario.k, scenario.min_distance_km, scenario.exclude_land_types, scenario.max_slope);
+            run.set_verbose(false);
+            run.filter_candidates();
+            for (int c : run.valid_candidates)
+                needed[c] = 1;
+        }
+
+        std::vector<int> targets;
+        for (size_t i = 0; i < needed.size(); i++)
+        {
+            if (needed[i])
+                targets.push_back(i);
+        }
+        prepare_graph_rows(targets);
+
+        std::vector<std::pair<std::vector<int>, double>> results(scenarios.size());
+        if (scenarios.empty())
+            return results;
+
+        const int workers = std::min<size_t>(num_threads, scenarios.size());
+        for (KMedoidsOptimizer &run : runs)
+            run.set_num_threads(std::max(1, num_threads / workers));
+
+        log() << "Running " << scenarios.size() << " scenarios on " << workers << " threads" << std::endl;
+        ThreadPool pool(workers);
+        pool.parallel_for(scenarios.size(), [&](size_t i, int)
+        {
+            results[i] = runs[i].optimize();
+            if (runs[i].capacitated() && !results[i].first.empty())
+                results[i].second = runs[i].transport_cost(results[i].first);
+        });
+
+        for (size_t i = 0; i < scenarios.size(); i++)
+        {
+            log() << "Scenario " << i + 1 << " (" << scenarios[i].name << "): ";
+            if (results[i].first.empty())
+                log() << "no valid solution" << std::endl;
+            else
+                log() << "cost = " << results[i].second << std::endl;
+        }
+        return results;
+    }
+
+    // Writes batch results in the optimization_results_export.json layout
+    void write_batch_results(std::ostream &out, const std::vector<Scenario> &scenarios,
+                             const std::vector<std::pair<std::vector<int>, double>> &results) const
+    {
+        static const char *algorithm_names[] = {"K-Medoids (PAM)", "K-Medoids (CLARA)", "K-Medoids (CLARANS)"};
+
+        std::time_t now = std::time(nullptr);
+        char timestamp[32];
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        out << std::setprecision(15);
+        out << "{\n  \"metadata\": {\n";
+        out << "    \"algorithm\": " << json_quote(algorithm_names[static_cast<int>(algorithm)]) << ",\n";
+        out << "    \"features\": [\n"
+            << "      \"Real road network distances\",\n"
+            << "      \"Terrain constraints (slope, land type)\",\n"
+            << "      \"Multi-constraint optimization\",\n"
+            << "      \"Spatial clustering for geographic data\"\n"
+            << "    ],\n";
+        out << "    \"timestamp\": " << json_quote(timestamp) << ",\n";
+        out << "    \"total_scenarios\": " << scenarios.size() << "\n  },\n";
+        out << "  \"scenarios\": [";
+
+        for (size_t i = 0; i < scenarios.size(); i++)
+        {
+            const Scenario &scenario = scenarios[i];
+            const std::vector<int> &medoids = results[i].first;
+            const bool success = !medoids.empty();
+
+            std::string exclude;
+            for (const std::string &type : scenario.exclude_land_types)
+                exclude += (exclude.empty() ? "" : ",") + type;
+
+            out << (i ? "," : "") << "\n    {\n";
+            out << "      \"name\": " << json_quote(scenario.name) << ",\n";
+            out << "      \"parameters\": {\n"
+                << "        \"name\": " << json_quote(scenario.name) << ",\n"
+                << "        \"description\": " << json_quote(scenario.description) << ",\n"
+                << "        \"num_centers\": " << scenario.k << ",\n"
+                << "        \"min_dist\": " << scenario.min_distance_km << ",\n"
+                << "        \"exclude_types\": " << json_quote(exclude.empty() ? "none" : exclude) << ",\n"
+                << "        \"max_slope\": " << scenario.max_slope << "\n"
+                << "      },\n";
+            out << "      \"num_centers_found\": " << medoids.size() << ",\n";
+            out << "      \"total_cost\": ";
+            if (success)
+                out << results[i].second;
+            else
+                out << "null";
+            out << ",\n      \"centers\": [";
+            for (size_t m = 0; m < medoids.size(); m++)
+            {
+                const Point &p = points[medoids[m]];
+                out << (m ? "," : "") << "\n        {\n"
+                    << "          \"id\": " << p.id << ",\n"
+                    << "          \"lat\": " << p.lat << ",\n"
+                    << "          \"lon\": " << p.lon << ",\n"
+                    << "          \"land_type\": " << json_quote(p.land_type) << ",\n"
+                    << "          \"slope\": " << p.slope << ",\n"
+                    << "          \"elevation\": " << p.elevation << "\n"
+                    << "        }";
+            }
+            out << (medoids.empty() ? "" : "\n      ") << "],\n";
+            out << "      \"success\": " << (success ? "true" : "false") << "\n    }";
+        }
+        out << (scenarios.empty() ? "" : "\n  ") << "]\n}\n";
+    }
+
+    enum class OutputFormat
+    {
+        Text,
+        Json,
+        Binary
+    };
+
+    // Writes the solution in the chosen format with a single write to out.
+    // Text keeps the historical "Best Centers / Assignments / Total Cost"
+    // layout; JSON and binary add each center's load. Capacitated results
+    // report the flow: loads and point counts per center, the quantity of
+    // every point share, the unserved quantity, and the transport cost
+    // without the overflow penalty in place of total_cost.
+    void print_results(const std::vector<int> &medoids, double total_cost,
+                       OutputFormat format = OutputFormat::Text, std::ostream &out = std::cout) const
+    {
+        PhaseTimer timer(stats.get(), "output");
+        const size_t n = points.size();
+        std::vector<int> assignments;
+        std::vector<double> loads(medoids.size(), 0.0);
+        std::vector<int> counts(medoids.size(), 0);
+        std::vector<std::tuple<int, int, double>> shares;
+        double unserved = 0.0;
+        const bool flow = capacitated();
+        if (flow)
+        {
+            std::vector<RowBuffer> bufs;
+            CapacitatedAssignment solved;
+            solve_capacitated(full_problem(), medoids, bufs, solved);
+            assignments = solved.assignments();
+            shares = solved.shares();
+            for (size_t j = 0; j < medoids.size(); j++)
+                loads[j] = solved.center_load(j);
+            for (const auto &[point, slot, quantity] : shares)
+                counts[slot]++;
+            unserved = solved.unserved();
+            total_cost = solved.transport_cost();
+        }
+        else
+        {
+            assignments = get_assignments(medoids);
+            for (size_t i = 0; i < n; i++)
+            {
+                loads[assignments[i]] += quantities[i];
+                counts[assignments[i]]++;
+            }
+        }
+
+        std::ostringstream doc;
+        if (format == OutputFormat::Binary)
+        {
+            BinaryResultHeader header;
+            std::memcpy(header.magic, binary_result_magic, sizeof(header.magic));
+            header.version = flow ? 2 : 1;
+            header.k = medoids.size();
+            header.n = n;
+            header.total_cost = total_cost;
+            std::vector<int32_t> center_ids(medoids.size()), point_ids(n), slots(assignments.begin(), assignments.end());
+            for (size_t j = 0; j < medoids.size(); j++)
+                center_ids[j] = points[medoids[j]].id;
+            for (size_t i = 0; i < n; i++)
+                point_ids[i] = points[i].id;
+
+            doc.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            doc.write(reinterpret_cast<const char *>(center_ids.data()), center_ids.size() * sizeof(int32_t));
+            doc.write(reinterpret_cast<const char *>(loads.data()), loads.size() * sizeof(double));
+            doc.write(reinterpret_cast<const char *>(point_ids.data()), n * sizeof(int32_t));
+            doc.write(reinterpret_cast<const char *>(slots.data()), n * sizeof(int32_t));
+            if (flow)
+            {
+                const uint64_t num_shares = shares.size();
+                std::vector<BinaryResultShare> records;
+                records.reserve(shares.size());
+                for (const auto &[point, slot, quantity] : shares)
+                    records.push_back({point, slot, quantity});
+                doc.write(reinterpret_cast<const char *>(&unserved), sizeof(unserved));
+                doc.write(reinterpret_cast<const char *>(&num_shares), sizeof(num_shares));
+                doc.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(BinaryResultShare));
+            }
+        }
+        else if (format == OutputFormat::Json)
+        {
+            doc << std::setprecision(15);
+            doc << "{\"total_cost\": " << total_cost << ", \"num_centers\": " << medoids.size() << ",\n";
+            if (flow)
+                doc << "\"unserved\": " << unserved << ",\n";
+            doc << "\"centers\": [";
+            for (size_t j = 0; j < medoids.size(); j++)
+            {
+                const Point &p = points[medoids[j]];
+                doc << (j ? ",\n" : "\n") << "{\"id\": " << p.id << ", \"lat\": " << p.lat << ", \"lon\": " << p.lon
+                    << ", \"land_type\": " << json_quote(p.land_type) << ", \"slope\": " << p.slope
+                    << ", \"elevation\": " << p.elevation << ", \"load\": " << loads[j]
+                    << ", \"num_points\": " << counts[j] << "}";
+            }
+            doc << "],\n\"point_ids\": [";
+            for (size_t i = 0; i < n; i++)
+                doc << (i ? "," : "") << points[i].id;
+            doc << "],\n\"assignments\": [";
+            for (size_t i = 0; i < n; i++)
+                doc << (i ? "," : "") << points[medoids[assignments[i]]].id;
+            doc << "]";
+            if (flow)
+            {
+                doc << ",\n\"shares\": [";
+                for (size_t s = 0; s < shares.size(); s++)
+                {
+                    const auto &[point, slot, quantity] = shares[s];
+                    doc << (s ? ",\n" : "\n") << "{\"point\": " << points[point].id << ", \"center\": "
+                        << points[medoids[slot]].id << ", \"quantity\": " << quantity << "}";
+                }
+                doc << "]";
+            }
+            doc << "}\n";
+        }
+        else
+        {
+            doc << "\nBest Centers:\n";
+            for (int medoid_idx : medoids)
+            {
+                const Point &p = points[medoid_idx];
+                doc << p.id << "," << p.lat << "," << p.lon << ","
+                    << p.land_type << "," << p.slope << "," << p.elevation << "\n";
+            }
+
+            doc << "\nAssignments:\n";
+            for (size_t i = 0; i < n; i++)
+            {
+                doc << "Point: " << points[i].id << " -> Center: "
+                    << points[medoids[assignments[i]]].id << "\n";
+            }
+
+            doc << "\nTotal Cost: " << total_cost << "\n";
+
+            // After Total Cost, where parsers of the historical layout stop
+            if (flow)
+            {
+                doc << "Unserved Quantity: " << unserved << "\n";
+                doc << "\nCenter Loads:\n";
+                for (size_t j = 0; j < medoids.size(); j++)
+                    doc << points[medoids[j]].id << "," << loads[j] << "," << counts[j] << "\n";
+
+                // Points not wholly served by their listed center
+                doc << "\nSplit Points:\n";
+                for (size_t s = 0, i = 0; i < n; i++)
+                {
+                    const size_t first = s;
+                    double served = 0.0;
+                    for (; s < shares.size() && std::get<0>(shares[s]) == static_cast<int>(i); s++)
+                        served += std::get<2>(shares[s]);
+                    const double missing = quantities[i] - served;
+                    if (s - first <= 1 && missing <= 1e-9 * std::max(quantities[i], 1.0))
+                        continue;
+                    doc << "Point: " << points[i].id << " ->";
+                    for (size_t t = first; t < s; t++)
+                        doc << (t > first ? "," : "") << " Center: " << points[medoids[std::get<1>(shares[t])]].id
+                            << " (" << std::get<2>(shares[t]) << ")";
+                    if (missing > 1e-9 * std::max(quantities[i], 1.0))
+                        doc << (s > first ? "," : "") << " Unserved (" << missing << ")";
+                    doc << "\n";
+                }
+            }
+        }
+
+        const std::string bytes = doc.str();
+        out.write(bytes.data(), bytes.size());
+        out.flush();
+    }
+};
+
+// Parses all of text as a number; false after reporting a malformed value
+template <typename T>
+bool parse_number(const std::string &text, const std::string &what, T &value)
+{
+    std::istringstream in(text);
+    if ((!std::is_unsigned<T>::value || text.find('-') == std::string::npos) && in >> value && (in >> std::ws).eof())
+        return true;
+    std::cerr << "Error: Invalid " << what << " " << text << std::endl;
+    return false;
+}
+
+// Applies the shared command-line options; false after reporting a bad value
+bool configure_optimizer(KMedoidsOptimizer &optimizer, std::map<std::string, std::string> &options)
+{
+    if (options.count("stats"))
+    {
+        optimizer.enable_stats();
+    }
+    if (options.count("simd") && !select_kernels(options["simd"]))
+    {
+        std::cerr << "Error: SIMD level " << options["simd"] << " is unknown or unsupported (expected auto, scalar, avx2 or avx512)" << std::endl;
+        return false;
+    }
+    if (options.count("threads"))
+    {
+        int threads;
+        if (!parse_number(options["threads"], "--threads", threads))
+            return false;
+        optimizer.set_num_threads(threads);
+    }
+    if (options.count("storage"))
+    {
+        if (options["storage"] == "candidates")
+        {
+            optimizer.set_storage_mode(KMedoidsOptimizer::StorageMode::Candidates);
+        }
+        else if (options["storage"] == "tiled")
+        {
+            optimizer.set_storage_mode(KMedoidsOptimizer::StorageMode::Tiled);
+        }
+        else if (options["storage"] != "dense")
+        {
+            std::cerr << "Error: Unknown storage mode " << options["storage"] << " (expected dense, candidates or tiled)" << std::endl;
+            return false;
+        }
+    }
+    if (options.count("tile-cache"))
+    {
+        long megabytes = 0;
+        if (!parse_number(options["tile-cache"], "--tile-cache", megabytes))
+            return false;
+        if (megabytes <= 0)
+        {
+            std::cerr << "Error: Invalid tile cache size " << options["tile-cache"] << " (expected megabytes > 0)" << std::endl;
+            return false;
+        }
+        optimizer.set_tile_cache(megabytes);
+    }
+
+    if (options.count("distance-precision"))
+    {
+        // f64, f32, or u16 with an optional meters-per-unit suffix (u16:10)
+        const std::string &precision = options["distance-precision"];
+        if (precision == "f64")
+            optimizer.set_distance_precision(DistanceMatrix::F64, 1.0);
+        else if (precision == "f32")
+            optimizer.set_distance_precision(DistanceMatrix::F32, 1.0);
+        else if (precision.rfind("u16", 0) == 0 && (precision.size() == 3 || precision[3] == ':'))
+        {
+            double unit = 10.0;
+            if (precision.size() > 3 && !parse_number(precision.substr(4), "u16 unit in --distance-precision", unit))
+                return false;
+            if (!(unit > 0))
+            {
+                std::cerr << "Error: Invalid u16 unit in " << precision << " (expected meters per unit > 0)" << std::endl;
+                return false;
+            }
+            optimizer.set_distance_precision(DistanceMatrix::U16, unit);
+        }
+        else
+        {
+            std::cerr << "Error: Unknown distance precision " << precision << " (expected f64, f32 or u16[:meters])" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.count("init"))
+    {
+        const std::string &init = options["init"];
+        if (init == "random")
+            optimizer.set_init_method(KMedoidsOptimizer::InitMethod::Random);
+        else if (init == "build")
+            optimizer.set_init_method(KMedoidsOptimizer::InitMethod::Build);
+        else if (init == "kmedoids++")
+            optimizer.set_init_method(KMedoidsOptimizer::InitMethod::KMedoidsPlusPlus);
+        else if (init == "lab")
+            optimizer.set_init_method(KMedoidsOptimizer::InitMethod::Lab);
+        else
+        {
+            std::cerr << "Error: Unknown init method " << init << " (expected random, build, kmedoids++ or lab)" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.count("algorithm"))
+    {
+        const std::string &algo = options["algorithm"];
+        if (algo == "pam")
+            optimizer.set_algorithm(KMedoidsOptimizer::Algorithm::Pam);
+        else if (algo == "clara")
+            optimizer.set_algorithm(KMedoidsOptimizer::Algorithm::Clara);
+        else if (algo == "clarans")
+            optimizer.set_algorithm(KMedoidsOptimizer::Algorithm::Clarans);
+        else
+        {
+            std::cerr << "Error: Unknown algorithm " << algo << " (expected pam, clara or clarans)" << std::endl;
+            return false;
+        }
+    }
+    if (options.count("capacity"))
+    {
+        const std::string &capacity = options["capacity"];
+        double units = 0.0;
+        if (capacity == "zone")
+            optimizer.set_zone_capacities();
+        else if (parse_number(capacity, "--capacity", units) && units > 0)
+            optimizer.set_uniform_capacity(units);
+        else
+        {
+            std::cerr << "Error: Invalid capacity " << capacity << " (expected a positive number or zone)" << std::endl;
+            return false;
+        }
+    }
+    // Against the effective settings, which may come from an earlier configure
+    if (optimizer.capacitated() && optimizer.get_algorithm() != KMedoidsOptimizer::Algorithm::Pam)
+    {
+        std::cerr << "Error: --capacity requires --algorithm pam" << std::endl;
+        return false;
+    }
+    if (options.count("seed"))
+    {
+        unsigned long long seed;
+        if (!parse_number(options["seed"], "--seed", seed))
+            return false;
+        optimizer.set_seed(seed);
+    }
+    if (options.count("restarts"))
+    {
+        int restarts;
+        if (!parse_number(options["restarts"], "--restarts", restarts))
+            return false;
+        optimizer.set_restarts(restarts);
+    }
+    if (options.count("time-budget") || options.count("max-evals"))
+    {
+        double seconds = 0.0;
+        long long evaluations = 0;
+        if ((options.count("time-budget") && !parse_number(options["time-budget"], "--time-budget", seconds)) ||
+            (options.count("max-evals") && !parse_number(options["max-evals"], "--max-evals", evaluations)))
+            return false;
+        if (seconds < 0 || evaluations < 0)
+        {
+            std::cerr << "Error: --time-budget and --max-evals must not be negative" << std::endl;
+            return false;
+        }
+        optimizer.set_search_budget(seconds, evaluations);
+    }
+    int samples = 0, sample_size = 0;
+    long neighbors = 0;
+    if ((options.count("samples") && !parse_number(options["samples"], "--samples", samples)) ||
+        (options.count("sample-size") && !parse_number(options["sample-size"], "--sample-size", sample_size)) ||
+        (options.count("max-neighbors") && !parse_number(options["max-neighbors"], "--max-neighbors", neighbors)))
+        return false;
+    optimizer.set_sampling(samples, sample_size, neighbors);
+    return true;
+}
+
+// Reads warm-start medoid IDs: a comma-separated list, a JSON results file
+// (centers of the first scenario), or a text/CSV file whose rows start with
+// an ID, such as the "Best Centers" lines of an earlier run.
+std::vector<int> load_initial_medoids(const std::string &source)
+{
+    std::vector<int> ids;
+    if (source.find_first_not_of("0123456789, ") == std::string::npos)
+    {
+        std::istringstream ss(source);
+        std::string token;
+        while (std::getline(ss, token, ','))
+        {
+            if (!token.empty())
+                ids.push_back(std::stoi(token));
+        }
+        return ids;
+    }
+
+    std::ifstream file(source);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open " + source);
+
+    if (source.size() >= 5 && source.compare(source.size() - 5, 5, ".json") == 0)
+    {
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        const std::string text = buffer.str();
+        const JsonValue root = JsonParser(text).parse();
+        const JsonValue *scenarios = root.find("scenarios");
+        const JsonValue *centers = (scenarios && scenarios->is_array() && !scenarios->array.empty())
+                                       ? scenarios->array[0].find("centers")
+                                       : nullptr;
+        if (!centers || !centers->is_array())
+            throw std::runtime_error(source + ": no scenarios[0].centers array");
+        for (const JsonValue &center : centers->array)
+        {
+            const JsonValue *id = center.find("id");
+            if (id && id->is_number())
+                ids.push_back(static_cast<int>(id->number));
+        }
+        return ids;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::string_view token(line);
+        token = token.substr(0, token.find(','));
+        while (!token.empty() && std::isspace(static_cast<unsigned char>(token.back())))
+            token.remove_suffix(1);
+        int id = 0;
+        auto result = std::from_chars(token.data(), token.data() + token.size(), id);
+        if (!token.empty() && result.ec == std::errc() && result.ptr == token.data() + token.size())
+            ids.push_back(id);
+    }
+    return ids;
+}
+
+// Splits a land type list on the given separators; "none" means empty
+std::set<std::string> parse_land_types(const std::string &list, const char *separators)
+{
+    std::set<std::string> types;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t stop = list.find_first_of(separators, start);
+        if (stop == std::string::npos)
+            stop = list.size();
+        std::string token = list.substr(start, stop - start);
+        token.erase(0, token.find_first_not_of(" \t"));
+        token.erase(token.find_last_not_of(" \t") + 1);
+        if (!token.empty() && token != "none")
+            types.insert(token);
+        start = stop + 1;
+    }
+    return types;
+}
+
+// Reads one JSON scenario object, either flat or with its constraints in a
+// "parameters" object; where prefixes error messages
+Scenario parse_scenario(const JsonValue &entry, const std::string &where)
+{
+    if (!entry.is_object())
+        throw std::runtime_error(where + " is not an object");
+    const JsonValue *params = entry.find("parameters");
+    if (!params || !params->is_object())
+        params = &entry;
+
+    auto field = [&](std::initializer_list<const char *> keys) -> const JsonValue *
+    {
+        for (const char *key : keys)
+        {
+            if (const JsonValue *v = params->find(key))
+                return v;
+            if (const JsonValue *v = entry.find(key))
+                return v;
+        }
+        return nullptr;
+    };
+    auto number = [&](const JsonValue *v, const char *what) -> double
+    {
+        if (!v->is_number())
+            throw std::runtime_error(where + ": " + what + " must be a number");
+        return v->number;
+    };
+
+    Scenario scenario;
+    const JsonValue *k = field({"num_centers", "k"});
+    if (!k)
+        throw std::runtime_error(where + " has no num_centers");
+    scenario.k = static_cast<int>(number(k, "num_centers"));
+    if (const JsonValue *v = field({"name"}); v && v->is_string())
+        scenario.name = v->string;
+    if (const JsonValue *v = field({"description"}); v && v->is_string())
+        scenario.description = v->string;
+    if (const JsonValue *v = field({"min_dist", "min_distance_km", "min_distance_from_each_other_km"}))
+        scenario.min_distance_km = number(v, "min_dist");
+    if (const JsonValue *v = field({"max_slope"}))
+        scenario.max_slope = number(v, "max_slope");
+    if (const JsonValue *v = field({"exclude_types", "exclude_land_types"}))
+    {
+        if (v->is_string())
+        {
+            scenario.exclude_land_types = parse_land_types(v->string, ",;");
+        }
+        else if (v->is_array())
+        {
+            for (const JsonValue &type : v->array)
+            {
+                if (type.is_string())
+                    scenario.exclude_land_types.insert(type.string);
+            }
+        }
+    }
+    return scenario;
+}
+
+// Reads batch scenarios from a CSV file (header naming the columns
+// name, description, num_centers, min_dist, exclude_types, max_slope, with
+// exclude_types separated by ';') or from JSON: an array of scenario objects
+// or an export file whose scenarios carry a "parameters" object. Missing
+// fields take the command-line defaults; num_centers (or k) is required.
+std::vector<Scenario> load_scenarios(const std::string &filename)
+{
+    std::vector<Scenario> scenarios;
+    const bool is_csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+
+    if (is_csv)
+    {
+        CsvReader csv;
+        if (!csv.open(filename))
+            throw std::runtime_error("Cannot open " + filename);
+        if (!csv.next_row())
+            return scenarios;
+
+        std::map<std::string, size_t> column;
+        for (size_t i = 0; i < csv.field_count(); i++)
+            column[std::string(csv.field(i))] = i;
+        auto find_column = [&](const char *name, const char *alias) -> long
+        {
+            auto it = column.find(name);
+            if (it == column.end())
+                it = column.find(alias);
+            return (it == column.end()) ? -1 : static_cast<long>(it->second);
+        };
+        const long name_col = find_column("name", "name");
+        const long description_col = find_column("description", "description");
+        const long k_col = find_column("num_centers", "k");
+        const long min_col = find_column("min_dist", "min_distance_km");
+        const long exclude_col = find_column("exclude_types", "exclude_land_types");
+        const long slope_col = find_column("max_slope", "max_slope");
+        if (k_col < 0)
+            csv.fail("missing num_centers column");
+
+        while (csv.next_row())
+        {
+            Scenario scenario;
+            auto has = [&](long col) { return col >= 0 && col < static_cast<long>(csv.field_count()) && !csv.field(col).empty(); };
+            csv.require_fields(k_col + 1);
+            scenario.k = csv.field_int(k_col);
+            if (has(name_col))
+                scenario.name = csv.field(name_col);
+            if (has(description_col))
+                scenario.description = csv.field(description_col);
+            if (has(min_col))
+                scenario.min_distance_km = csv.field_double(min_col);
+            if (has(exclude_col))
+                scenario.exclude_land_types = parse_land_types(std::string(csv.field(exclude_col)), ";|");
+            if (has(slope_col))
+                scenario.max_slope = csv.field_double(slope_col);
+            if (scenario.name.empty())
+                scenario.name = "Scenario " + std::to_string(scenarios.size() + 1);
+            scenarios.push_back(scenario);
+        }
+        return scenarios;
+    }
+
+    std::ifstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open " + filename);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+    const JsonValue root = JsonParser(text).parse();
+
+    const JsonValue *list = &root;
+    if (root.is_object())
+        list = root.find("scenarios");
+    if (!list || !list->is_array())
+        throw std::runtime_error(filename + ": expected a scenario array or an object with \"scenarios\"");
+
+    for (const JsonValue &entry : list->array)
+    {
+        Scenario scenario = parse_scenario(entry, filename + ": scenario " + std::to_string(scenarios.size() + 1));
+        if (scenario.name.empty())
+            scenario.name = "Scenario " + std::to_string(scenarios.size() + 1);
+        scenarios.push_back(scenario);
+    }
+    return scenarios;
+}
+
+// Writes a synthetic dataset (resource_points.csv, zone_features.csv,
+// road_network.csv) into dir: n points on a jittered grid about one degree
+// wide, a candidate_ratio share of them on buildable land under 20% slope,
+// and roads either as a dense km matrix or as a grid edge list in meters.
+// Road lengths are the straight-line distance times 1.3.
+void write_synthetic_dataset(const std::string &dir, size_t n, double candidate_ratio, bool dense_roads, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const size_t side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(n))));
+    const double spacing = 1.0 / side;
+    const char *buildable[] = {"agricultural", "barren", "forest"};
+
+    std::vector<double> lat(n), lon(n);
+    std::ostringstream resources, zones;
+    resources << "id,latitude,longitude,resource_quantity\n";
+    zones << "id,slope,elevation,land_type\n";
+    resources << std::setprecision(10);
+    for (size_t i = 0; i < n; i++)
+    {
+        lat[i] = 25.7 + ((i / side) + unit(gen)) * spacing;
+        lon[i] = 74.9 + ((i % side) + unit(gen)) * spacing;
+        resources << i + 1 << "," << lat[i] << "," << lon[i] << "," << 100 + static_cast<int>(unit(gen) * 900) << "\n";
+
+        const bool candidate = unit(gen) < candidate_ratio;
+        zones << i + 1 << "," << (candidate ? unit(gen) * 20 : 20 + unit(gen) * 20) << "," << 300 + unit(gen) * 300 << ","
+              << (candidate ? buildable[gen() % 3] : "wetland") << "\n";
+    }
+
+    auto road_km = [&](size_t a, size_t b)
+    {
+        return 1.3 * KMedoidsOptimizer::haversine_distance(lat[a], lon[a], lat[b], lon[b]) / 1000.0;
+    };
+
+    std::ostringstream roads;
+    roads << std::fixed << std::setprecision(3);
+    if (dense_roads)
+    {
+        roads << "from_point";
+        for (size_t j = 0; j < n; j++)
+            roads << ",p" << j + 1;
+        roads << "\n";
+        for (size_t i = 0; i < n; i++)
+        {
+            roads << "p" << i + 1;
+            for (size_t j = 0; j < n; j++)
+                roads << "," << road_km(i, j);
+            roads << "\n";
+        }
+    }
+    else
+    {
+        // Right, down and one diagonal neighbour on the grid
+        roads << "From_ID,To_ID,Distance\n";
+        for (size_t i = 0; i < n; i++)
+        {
+            const size_t neighbours[] = {(i % side + 1 < side) ? i + 1 : n, i + side, (i % side + 1 < side) ? i + side + 1 : n};
+            for (size_t j : neighbours)
+            {
+                if (j < n)
+                    roads << i + 1 << "," << j + 1 << "," << road_km(i, j) * 1000.0 << "\n";
+            }
+        }
+    }
+
+    const std::pair<const char *, std::ostringstream *> files[] = {
+        {"/resource_points.csv", &resources}, {"/zone_features.csv", &zones}, {"/road_network.csv", &roads}};
+    for (const auto &file : files)
+    {
+        std::ofstream out(dir + file.first);
+        out << file.second->str();
+        if (!out)
+            throw std::runtime_error("Cannot write " + dir + file.first);
+    }
+}
+
+// Comma-separated list of numbers for the bench grid options
+std::vector<double> parse_number_list(const std::string &list)
+{
+    std::vector<double> values;
+    std::istringstream ss(list);
+    std::string token;
+    while (std::getline(ss, token, ','))
+    {
+        if (!token.empty())
+            values.push_back(std::stod(token));
+    }
+    return values;
+}
+
+// bench: time every phase over a grid of N, k and candidate ratios on
+// generated datasets and write one result row per configuration
+int run_bench(std::map<std::string, std::string> &options)
+{
+    const std::vector<double> sizes = parse_number_list(options.count("sizes") ? options["sizes"] : "1000,5000");
+    const std::vector<double> ks = parse_number_list(options.count("k") ? options["k"] : "5,20");
+    const std::vector<double> ratios = parse_number_list(options.count("candidate-ratios") ? options["candidate-ratios"] : "1,0.25");
+    const std::string roads = options.count("roads") ? options["roads"] : "edges";
+    const std::string out_file = options.count("out") ? options["out"] : "bench_results.csv";
+    unsigned data_seed = 1;
+    if (options.count("data-seed") && !parse_number(options["data-seed"], "--data-seed", data_seed))
+        return 1;
+    if (roads != "edges" && roads != "dense" && roads != "none")
+    {
+        std::cerr << "Error: Unknown road mode " << roads << " (expected edges, dense or none)" << std::endl;
+        return 1;
+    }
+    if (!options.count("seed"))
+        options["seed"] = "42";
+
+    char dir_template[] = "/tmp/center_bench_XXXXXX";
+    if (!mkdtemp(dir_template))
+    {
+        std::cerr << "Error: Cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+    const std::string dir = dir_template;
+
+    struct Row
+    {
+        size_t n;
+        int k;
+        double ratio;
+        double load;
+        KMedoidsOptimizer::PhaseTimes times;
+    };
+    std::vector<Row> rows;
+
+    for (double size : sizes)
+    {
+        for (double ratio : ratios)
+        {
+            const size_t n = static_cast<size_t>(size);
+            try
+            {
+                write_synthetic_dataset(dir, n, ratio, roads == "dense", data_seed);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+
+            for (double k_value : ks)
+            {
+                const int k = static_cast<int>(k_value);
+                KMedoidsOptimizer optimizer(k, 0.0, {"wetland"}, 25.0);
+                if (!configure_optimizer(optimizer, options))
+                    return 1;
+                optimizer.set_verbose(false);
+
+                auto start = std::chrono::steady_clock::now();
+                optimizer.load_points(dir + "/resource_points.csv");
+                optimizer.load_zone_features(dir + "/zone_features.csv");
+                if (roads != "none")
+                    optimizer.load_distances(dir + "/road_network.csv");
+                const double load = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                Row row{n, k, ratio, load, optimizer.profile_optimize()};
+                const KMedoidsOptimizer::PhaseTimes &t = row.times;
+                std::cout << "N=" << n << " k=" << k << " ratio=" << ratio << ": load " << load << "s, filter " << t.filter
+                          << "s, init " << t.init << "s, swap " << t.swap << "s (" << t.iterations << " iterations), cost "
+                          << t.cost << "s, output " << t.output << "s" << std::endl;
+                rows.push_back(row);
+            }
+        }
+    }
+
+    const char *names[] = {"/resource_points.csv", "/zone_features.csv", "/road_network.csv"};
+    for (const char *name : names)
+        unlink((dir + name).c_str());
+    rmdir(dir.c_str());
+
+    const bool json = out_file.size() >= 5 && out_file.compare(out_file.size() - 5, 5, ".json") == 0;
+    std::ostringstream doc;
+    doc << std::setprecision(10);
+    if (json)
+        doc << "[";
+    else
+        doc << "n,k,candidate_ratio,roads,candidates,load_s,filter_s,init_s,swap_s,iterations,cost_eval_s,output_s,total_cost\n";
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const Row &r = rows[i];
+        const KMedoidsOptimizer::PhaseTimes &t = r.times;
+        if (json)
+        {
+            doc << (i ? ",\n " : "\n ") << "{\"n\": " << r.n << ", \"k\": " << r.k << ", \"candidate_ratio\": " << r.ratio
+                << ", \"roads\": " << json_quote(roads) << ", \"candidates\": " << t.candidates << ", \"load_s\": " << r.load
+                << ", \"filter_s\": " << t.filter << ", \"init_s\": " << t.init << ", \"swap_s\": " << t.swap
+                << ", \"iterations\": " << t.iterations << ", \"cost_eval_s\": " << t.cost << ", \"output_s\": " << t.output
+                << ", \"total_cost\": " << t.total_cost << "}";
+        }
+        else
+        {
+            doc << r.n << "," << r.k << "," << r.ratio << "," << roads << "," << t.candidates << "," << r.load << ","
+                << t.filter << "," << t.init << "," << t.swap << "," << t.iterations << "," << t.cost << ","
+                << t.output << "," << t.total_cost << "\n";
+        }
+    }
+    if (json)
+        doc << "\n]\n";
+
+    std::ofstream out(out_file);
+    if (!out.is_open() || !(out << doc.str()))
+    {
+        std::cerr << "Error: Cannot write " << out_file << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << rows.size() << " benchmark results to " << out_file << std::endl;
+    return 0;
+}
+
+// Writes the --stats JSON block to the named file, or to stderr for "-"
+bool write_stats(const KMedoidsOptimizer &optimizer, const std::string &target)
+{
+    RunStats *stats = optimizer.get_stats();
+    if (!stats)
+        return true;
+    if (target == "-")
+    {
+        stats->write_json(std::cerr);
+        return true;
+    }
+    std::ofstream out(target);
+    if (!out.is_open())
+    {
+        std::cerr << "Error: Cannot write " << target << std::endl;
+        return false;
+    }
+    stats->write_json(out);
+    return true;
+}
+
+// Option values of a JSON object as the command line would spell them
+std::map<std::string, std::string> json_options(const JsonValue *options)
+{
+    std::map<std::string, std::string> out;
+    if (!options)
+        return out;
+    if (!options->is_object())
+        throw std::runtime_error("\"options\" must be an object");
+    for (const auto &member : options->object)
+    {
+        std::string name = member.first;
+        std::replace(name.begin(), name.end(), '_', '-');
+        const JsonValue &v = member.second;
+        if (v.is_string())
+        {
+            out[name] = v.string;
+        }
+        else if (v.is_number())
+        {
+            std::ostringstream text;
+            text << std::setprecision(17) << v.number;
+            out[name] = text.str();
+        }
+        else
+        {
+            throw std::runtime_error("option " + member.first + " must be a string or a number");
+        }
+    }
+    return out;
+}
+
+// Writes all of bytes to a socket; false once the peer has gone away
+bool send_all(int fd, const std::string &bytes)
+{
+    size_t sent = 0;
+    while (sent < bytes.size())
+    {
+        const ssize_t n = ::send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Long-running solver behind a Unix domain socket. Datasets are loaded once
+// under a name and stay resident; each solve copies the dataset's optimizer,
+// which shares its point data, distance matrix and road rows, and applies
+// the request's constraints. Requests and responses are one JSON object per line,
+// answered in order on each connection; solves from all connections share a
+// fixed pool of request workers.
+class SolveServer
+{
+private:
+    std::map<std::string, std::string> defaults; // Optimizer options applied at load
+    int solve_threads;
+    bool verbose;
+
+    std::mutex datasets_mutex;
+    std::map<std::string, std::shared_ptr<const KMedoidsOptimizer>> datasets;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    std::deque<std::packaged_task<std::string()>> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    int listen_fd = -1;
+    std::mutex clients_mutex;
+    std::condition_variable clients_done;
+    std::set<int> clients;
+    size_t active_connections = 0;
+
+    static const size_t max_request_bytes = 64 << 20;
+
+    // "id" is echoed so clients can match responses; strings and numbers only
+    static std::string echo_id(const JsonValue &request)
+    {
+        const JsonValue *id = request.find("id");
+        if (!id)
+            return "";
+        std::ostringstream out;
+        out << std::setprecision(17) << "\"id\": ";
+        if (id->is_string())
+            out << json_quote(id->string);
+        else if (id->is_number())
+            out << id->number;
+        else
+            return "";
+        return out.str() + ", ";
+    }
+
+    static std::string error_response(const std::string &id, const std::string &message)
+    {
+        return "{" + id + "\"ok\": false, \"error\": " + json_quote(message) + "}";
+    }
+
+    static std::string string_field(const JsonValue &request, const char *key, bool required)
+    {
+        const JsonValue *v = request.find(key);
+        if (!v)
+        {
+            if (required)
+                throw std::runtime_error(std::string("missing \"") + key + "\"");
+            return "";
+        }
+        if (!v->is_string())
+            throw std::runtime_error(std::string("\"") + key + "\" must be a string");
+        return v->string;
+    }
+
+    std::shared_ptr<const KMedoidsOptimizer> find_dataset(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(datasets_mutex);
+        auto it = datasets.find(name);
+        if (it == datasets.end())
+            throw std::runtime_error("no dataset named " + name);
+        return it->second;
+    }
+
+    std::string load(const JsonValue &request, const std::string &id)
+    {
+        const std::string name = string_field(request, "dataset", true);
+        const std::string resource_file = string_field(request, "resource_file", true);
+        const std::string zone_file = string_field(request, "zone_file", true);
+        const std::string road_file = string_field(request, "road_file", true);
+
+        auto optimizer = std::make_shared<KMedoidsOptimizer>(0, 0.0, std::set<std::string>(), 0.0);
+        std::map<std::string, std::string> options = defaults;
+        if (!configure_optimizer(*optimizer, options))
+            throw std::runtime_error("invalid server options");
+        optimizer->set_verbose(verbose);
+        if (!optimizer->load_points(resource_file) || optimizer->get_points().empty())
+            throw std::runtime_error("no points loaded from " + resource_file);
+        if (!optimizer->load_zone_features(zone_file))
+            throw std::runtime_error("cannot load zone features from " + zone_file);
+        if (road_file != "none" && !optimizer->load_distances(road_file))
+            throw std::runtime_error("cannot load road distances from " + road_file);
+
+        const size_t n = optimizer->get_points().size();
+        {
+            std::lock_guard<std::mutex> lock(datasets_mutex);
+            datasets[name] = optimizer; // Solves still running keep the old copy
+        }
+        if (verbose)
+            std::cout << "Loaded dataset " << name << " (" << n << " points)" << std::endl;
+        return "{" + id + "\"ok\": true, \"dataset\": " + json_quote(name) + ", \"num_points\": " + std::to_string(n) + "}";
+    }
+
+    std::string solve(const JsonValue &request, const std::string &id)
+    {
+        const std::string name = string_field(request, "dataset", true);
+        const Scenario scenario = parse_scenario(request, "solve request");
+        std::map<std::string, std::string> options = json_options(request.find("options"));
+        for (const char *global : {"simd", "stats"})
+        {
+            if (options.count(global))
+                throw std::runtime_error(std::string("option ") + global + " can only be set when the server starts");
+        }
+        // The option could name a server-side file; warm starts are inline
+        if (options.count("initial-medoids"))
+            throw std::runtime_error("option initial-medoids is not accepted; send \"initial_medoids\" as an array of point IDs");
+        std::vector<int> initial_ids;
+        if (const JsonValue *warm = request.find("initial_medoids"))
+        {
+            if (!warm->is_array())
+                throw std::runtime_error("\"initial_medoids\" must be an array of point IDs");
+            for (const JsonValue &id : warm->array)
+            {
+                if (!id.is_number() || id.number != std::floor(id.number) || std::abs(id.number) > std::numeric_limits<int>::max())
+                    throw std::runtime_error("\"initial_medoids\" must be an array of point IDs");
+                initial_ids.push_back(static_cast<int>(id.number));
+            }
+        }
+
+        // Shares the dataset's points and distances; only solve state is new
+        KMedoidsOptimizer run = *find_dataset(name);
+        run.set_verbose(false);
+        run.set_num_threads(solve_threads);
+        if (!configure_optimizer(run, options))
+            throw std::runtime_error("invalid value in \"options\"");
+        run.set_initial_medoids(initial_ids);
+        run.set_constraints(scenario.k, scenario.min_distance_km, scenario.exclude_land_types, scenario.max_slope);
+
+        const auto start = std::chrono::steady_clock::now();
+        auto result = run.optimize();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (result.first.empty())
+            throw std::runtime_error("no valid solution");
+
+        std::ostringstream document;
+        run.print_results(result.first, result.second, KMedoidsOptimizer::OutputFormat::Json, document);
+        std::string body = document.str();
+        body.erase(std::remove(body.begin(), body.end(), '\n'), body.end());
+
+        std::ostringstream out;
+        out << std::setprecision(6) << "{" << id << "\"ok\": true, \"dataset\": " << json_quote(name)
+            << ", \"seconds\": " << seconds << ", \"result\": " << body << "}";
+        return out.str();
+    }
+
+    std::string handle(const std::string &line)
+    {
+        std::string id;
+        try
+        {
+            const JsonValue request = JsonParser(line).parse();
+            if (!request.is_object())
+                throw std::runtime_error("request must be a JSON object");
+            id = echo_id(request);
+            const std::string op = string_field(request, "op", true);
+            if (op == "solve")
+                return solve(request, id);
+            if (op == "load")
+                return load(request, id);
+            if (op == "unload")
+            {
+                const std::string name = string_field(request, "dataset", true);
+                std::lock_guard<std::mutex> lock(datasets_mutex);
+                if (!datasets.erase(name))
+                    throw std::runtime_error("no dataset named " + name);
+                return "{" + id + "\"ok\": true}";
+            }
+            if (op == "list")
+            {
+                std::ostringstream out;
+                out << "{" << id << "\"ok\": true, \"datasets\": [";
+                std::lock_guard<std::mutex> lock(datasets_mutex);
+                for (auto it = datasets.begin(); it != datasets.end(); ++it)
+                {
+                    out << (it == datasets.begin() ? "" : ", ") << "{\"name\": " << json_quote(it->first)
+                        << ", \"num_points\": " << it->second->get_points().size() << "}";
+                }
+                out << "]}";
+                return out.str();
+            }
+            if (op == "shutdown")
+            {
+                begin_stop();
+                return "{" + id + "\"ok\": true}";
+            }
+            throw std::runtime_error("unknown op " + op + " (expected load, solve, unload, list or shutdown)");
+        }
+        catch (const std::exception &e)
+        {
+            return error_response(id, e.what());
+        }
+    }
+
+    std::future<std::string> submit(std::string line)
+    {
+        std::packaged_task<std::string()> task([this, line = std::move(line)] { return handle(line); });
+        std::future<std::string> result = task.get_future();
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (!stopping)
+            {
+                queue.push_back(std::move(task));
+                queue_ready.notify_one();
+                return result;
+            }
+        }
+        std::promise<std::string> refused;
+        refused.set_value(error_response("", "server is shutting down"));
+        return refused.get_future();
+    }
+
+    void work()
+    {
+        for (;;)
+        {
+            std::packaged_task<std::string()> task;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+
+    // Requests already queued still run; new ones are refused
+    void begin_stop()
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+        queue_ready.notify_all();
+        ::shutdown(listen_fd, SHUT_RDWR);
+    }
+
+    // Reads request lines and hands them to the workers; a writer thread
+    // sends the answers back in request order
+    void serve_connection(int fd)
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::future<std::string>> pending;
+        bool done = false;
+
+        std::thread writer([&]
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;)
+            {
+                ready.wait(lock, [&] { return done || !pending.empty(); });
+                if (pending.empty())
+                    return;
+                std::future<std::string> next = std::move(pending.front());
+                pending.pop_front();
+                lock.unlock();
+                send_all(fd, next.get() + "\n"); // Answers to a departed client are dropped
+                lock.lock();
+            }
+        });
+
+        std::string buffer;
+        std::vector<char> chunk(1 << 16);
+        for (;;)
+        {
+            const ssize_t got = ::recv(fd, chunk.data(), chunk.size(), 0);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                break;
+            buffer.append(chunk.data(), got);
+
+            size_t start = 0;
+            for (size_t end; (end = buffer.find('\n', start)) != std::string::npos; start = end + 1)
+            {
+                std::string line = buffer.substr(start, end - start);
+                if (line.find_first_not_of(" \t\r") == std::string::npos)
+                    continue;
+                std::future<std::string> result = submit(std::move(line));
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.push_back(std::move(result));
+                ready.notify_one();
+            }
+            buffer.erase(0, start);
+            if (buffer.size() > max_request_bytes)
+            {
+                std::cerr << "Error: Dropping a client whose request exceeds " << (max_request_bytes >> 20) << " MB" << std::endl;
+                break;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            ready.notify_one();
+        }
+        writer.join();
+
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        clients.erase(fd);
+        ::close(fd);
+        active_connections--;
+        clients_done.notify_all();
+    }
+
+public:
+    SolveServer(std::map<std::string, std::string> options, int request_workers, int threads_per_solve,
+                bool verbose_output = true)
+        : defaults(std::move(options)), solve_threads(std::max(1, threads_per_solve)), verbose(verbose_output)
+    {
+        workers.resize(std::max(1, request_workers));
+    }
+
+    // Serves until a shutdown request; false if the socket cannot be opened
+    bool run(const std::string &socket_path)
+    {
+        sockaddr_un address{};
+        if (socket_path.size() >= sizeof(address.sun_path))
+        {
+            std::cerr << "Error: Socket path " << socket_path << " is too long" << std::endl;
+            return false;
+        }
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+        // Only a stale socket from an earlier run is replaced
+        struct stat existing;
+        if (::lstat(socket_path.c_str(), &existing) == 0)
+        {
+            if (!S_ISSOCK(existing.st_mode))
+            {
+                std::cerr << "Error: " << socket_path << " exists and is not a socket" << std::endl;
+                return false;
+            }
+            const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            const bool live = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+            if (probe >= 0)
+                ::close(probe);
+            if (live)
+            {
+                std::cerr << "Error: Another server is listening on " << socket_path << std::endl;
+                return false;
+            }
+            ::unlink(socket_path.c_str());
+        }
 
-        std::map<int, Point> zone_map;
-        while (std::getline(file, line))
+        // Requests can read any file the server can and shut it down, so
+        // only the owner may connect; the umask closes the window before chmod
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const mode_t old_mask = ::umask(0177);
+        const bool bound = listen_fd >= 0 && ::bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+        ::umask(old_mask);
+        if (!bound || ::chmod(socket_path.c_str(), 0600) != 0 || ::listen(listen_fd, 64) != 0)
         {
-            std::istringstream ss(line);
-            std::string token;
-            Point zone;
-
-            // Parse CSV: id,slope,elevation,land_type
-            if (std::getline(ss, token, ','))
-                zone.id = std::stoi(token);
-            if (std::getline(ss, token, ','))
-                zone.slope = std::stod(token);
-            if (std::getline(ss, token, ','))
-                zone.elevation = std::stod(token);
-            if (std::getline(ss, token, ','))
-                zone.land_type = token;
-
-            zone_map[zone.id] = zone;
+            std::cerr << "Error: Cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+            if (bound)
+                ::unlink(socket_path.c_str());
+            if (listen_fd >= 0)
+                ::close(listen_fd);
+            return false;
         }
-        file.close();
 
-        // Merge zone features with points
-        for (auto &point : points)
+        for (std::thread &worker : workers)
+            worker = std::thread(&SolveServer::work, this);
+        if (verbose)
+            std::cout << "Listening on " << socket_path << " with " << workers.size() << " request workers, "
+                      << solve_threads << " threads per solve" << std::endl;
+
+        for (;;)
         {
-            if (zone_map.find(point.id) != zone_map.end())
+            const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0)
             {
-                const Point &zone = zone_map[point.id];
-                point.land_type = zone.land_type;
-                point.slope = zone.slope;
-                point.elevation = zone.elevation;
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                break; // Shut down by begin_stop
             }
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            clients.insert(fd);
+            active_connections++;
+            std::thread(&SolveServer::serve_connection, this, fd).detach();
         }
-        std::cout << "Loaded zone features for " << zone_map.size() << " locations" << std::endl;
+
+        // Finish queued requests, then stop reading so connections drain
+        for (std::thread &worker : workers)
+            worker.join();
+        std::unique_lock<std::mutex> lock(clients_mutex);
+        for (int fd : clients)
+            ::shutdown(fd, SHUT_RD);
+        clients_done.wait(lock, [this] { return active_connections == 0; });
+        ::close(listen_fd);
+        ::unlink(socket_path.c_str());
+        if (verbose)
+            std::cout << "Server stopped" << std::endl;
+        return true;
     }
+};
 
-    void load_distances(const std::string &filename)
-    {
-        std::ifstream file(filename);
-        if (!file.is_open())
-        {
-            std::cerr << "Error: Cannot open " << filename << std::endl;
-            return;
-        }
+// Newline-delimited reads from a socket
+class LineReader
+{
+private:
+    int fd;
+    std::string buffer;
+    size_t start = 0;
 
-        std::string line;
-        std::getline(file, line); // Header with point IDs
+public:
+    explicit LineReader(int socket) : fd(socket) {}
 
-        int row = 0;
-        while (std::getline(file, line))
+    // Next line without its newline; false at end of stream
+    bool next(std::string &line)
+    {
+        for (;;)
         {
-            std::istringstream ss(line);
-            std::string token;
-            std::getline(ss, token, ','); // Skip row label
-
-            int col = 0;
-            while (std::getline(ss, token, ','))
+            const size_t end = buffer.find('\n', start);
+            if (end != std::string::npos)
             {
-                if (row < points.size() && col < points.size())
-                {
-                    double dist = std::stod(token);
-                    std::string from_key = std::to_string(points[row].id);
-                    std::string to_key = std::to_string(points[col].id);
-                    distance_matrix[from_key][to_key] = dist * 1000; // Convert km to meters
-                }
-                col++;
+                line.assign(buffer, start, end - start);
+                start = end + 1;
+                return true;
             }
-            row++;
+            buffer.erase(0, start);
+            start = 0;
+            char chunk[1 << 16];
+            const ssize_t got = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                return false;
+            buffer.append(chunk, got);
         }
-        file.close();
-        std::cout << "Loaded distance matrix" << std::endl;
     }
+};
+
+// TCP endpoint "host:port"; an empty or "*" host listens on every interface
+int open_tcp(const std::string &endpoint, bool listening)
+{
+    const size_t colon = endpoint.rfind(':');
+    if (colon == std::string::npos)
+    {
+        std::cerr << "Error: Expected host:port, got " << endpoint << std::endl;
+        return -1;
+    }
+    std::string host = endpoint.substr(0, colon);
+    const std::string port = endpoint.substr(colon + 1);
+    if (host == "*")
+        host.clear();
 
-    double get_distance(int from_id, int to_id)
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo *found = nullptr;
+    if (const int status = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found))
     {
-        std::string from_key = std::to_string(from_id);
-        std::string to_key = std::to_string(to_id);
+        std::cerr << "Error: Cannot resolve " << endpoint << ": " << gai_strerror(status) << std::endl;
+        return -1;
+    }
 
-        if (distance_matrix.find(from_key) != distance_matrix.end() &&
-            distance_matrix[from_key].find(to_key) != distance_matrix[from_key].end())
+    int fd = -1;
+    for (addrinfo *a = found; a && fd < 0; a = a->ai_next)
+    {
+        fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+        if (fd < 0)
+            continue;
+        const int one = 1;
+        bool ok;
+        if (listening)
         {
-            return distance_matrix[from_key][to_key];
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = ::bind(fd, a->ai_addr, a->ai_addrlen) == 0 && ::listen(fd, 16) == 0;
         }
-
-        // Fallback to Haversine distance
-        Point from_point, to_point;
-        for (const auto &p : points)
+        else
         {
-            if (p.id == from_id)
-                from_point = p;
-            if (p.id == to_id)
-                to_point = p;
+            ok = ::connect(fd, a->ai_addr, a->ai_addrlen) == 0;
         }
-
-        return haversine_distance(from_point.lat, from_point.lon, to_point.lat, to_point.lon);
+        if (!ok)
+        {
+            ::close(fd);
+            fd = -1;
+            continue;
+        }
+        // Passes are small request/reply messages, so do not batch them
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
     }
+    ::freeaddrinfo(found);
+    if (fd < 0)
+        std::cerr << "Error: Cannot " << (listening ? "listen on " : "connect to ") << endpoint << ": " << std::strerror(errno) << std::endl;
+    return fd;
+}
+
+// Host part of a "host:port" endpoint names the loopback interface
+bool is_loopback_endpoint(const std::string &endpoint)
+{
+    const std::string host = endpoint.substr(0, endpoint.rfind(':'));
+    return host == "localhost" || host == "::1" || host == "[::1]" || host.rfind("127.", 0) == 0;
+}
 
-    double haversine_distance(double lat1, double lon1, double lat2, double lon2)
+// Worker node of a distributed solve. Serves one coordinator at a time: a
+// setup request loads the data and takes a share of the candidates, then
+// each pass request carries the k medoids and is answered with the best
+// swap of the share, so messages are O(k) however large the problem. The
+// worker reads medoid rows from its own copy of the distances, which must
+// be a binary matrix or a road edge list.
+//
+// Setup names files that the worker opens with its own permissions, so a
+// worker trusts every coordinator that can reach it: it listens on loopback
+// unless told otherwise, and then requires the shared --token in setup.
+class PartitionWorker
+{
+private:
+    int threads;
+    std::string token;
+    bool verbose;
+
+    // Non-negative integer below limit, or an error naming what
+    static size_t integer(const JsonValue *v, const char *what, size_t limit)
     {
-        const double R = 6371000; // Earth radius in meters
-        double dlat = (lat2 - lat1) * M_PI / 180.0;
-        double dlon = (lon2 - lon1) * M_PI / 180.0;
-        double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1 * M_PI / 180.0) * cos(lat2 * M_PI / 180.0) * sin(dlon / 2) * sin(dlon / 2);
-        double c = 2 * atan2(sqrt(a), sqrt(1 - a));
-        return R * c;
+        if (!v || !v->is_number() || !(v->number >= 0 && v->number < static_cast<double>(limit)) ||
+            v->number != std::floor(v->number))
+            throw std::runtime_error(std::string("\"") + what + "\" must be an integer from 0 to " + std::to_string(limit - 1));
+        return static_cast<size_t>(v->number);
     }
 
-    void filter_candidates()
+    void session(int fd)
     {
-        valid_candidates.clear();
-
-        for (int i = 0; i < points.size(); i++)
+        LineReader reader(fd);
+        std::unique_ptr<KMedoidsOptimizer> optimizer;
+        std::unique_ptr<KMedoidsOptimizer::Partition> partition;
+        std::unique_ptr<ThreadPool> pool;
+        std::string line;
+        while (reader.next(line))
         {
-            const Point &p = points[i];
-
-            // Check land type exclusions
-            if (exclude_land_types.find(p.land_type) != exclude_land_types.end())
+            std::ostringstream out;
+            out << std::setprecision(17);
+            try
             {
-                continue;
-            }
+                const JsonValue request = JsonParser(line).parse();
+                const JsonValue *op = request.find("op");
+                if (!op || !op->is_string())
+                    throw std::runtime_error("missing \"op\"");
 
-            // Check slope constraint
-            if (p.slope > max_slope)
+                if (op->string == "setup")
+                {
+                    auto text = [&](const char *key) -> std::string
+                    {
+                        const JsonValue *v = request.find(key);
+                        if (!v || !v->is_string())
+                            throw std::runtime_error(std::string("missing \"") + key + "\"");
+                        return v->string;
+                    };
+                    const JsonValue *sent = request.find("token");
+                    if (!token.empty() && (!sent || !sent->is_string() || sent->string != token))
+                    {
+                        send_all(fd, "{\"ok\": false, \"error\": \"invalid token\"}\n");
+                        break;
+                    }
+                    const Scenario scenario = parse_scenario(request, "setup request");
+                    const size_t parts = integer(request.find("parts"), "parts", 1 << 16);
+                    if (parts == 0)
+                        throw std::runtime_error("\"parts\" must be positive");
+                    const size_t part = integer(request.find("part"), "part", parts);
+                    std::map<std::string, std::string> options = json_options(request.find("options"));
+
+                    partition.reset();
+                    optimizer = std::make_unique<KMedoidsOptimizer>(scenario.k, scenario.min_distance_km,
+                                                                    scenario.exclude_land_types, scenario.max_slope);
+                    if (!configure_optimizer(*optimizer, options))
+                        throw std::runtime_error("invalid value in \"options\"");
+                    optimizer->set_num_threads(threads);
+                    optimizer->set_verbose(verbose);
+                    optimizer->load_points(text("resource_file"));
+                    if (optimizer->get_points().empty())
+                        throw std::runtime_error("no points loaded from " + text("resource_file"));
+                    optimizer->load_zone_features(text("zone_file"));
+                    partition = std::make_unique<KMedoidsOptimizer::Partition>();
+                    optimizer->begin_partition(*partition, part, parts, text("road_file"));
+                    pool = std::make_unique<ThreadPool>(threads);
+                    out << "{\"ok\": true, \"num_points\": " << optimizer->get_points().size()
+                        << ", \"num_candidates\": " << optimizer->get_valid_candidates().size()
+                        << ", \"first\": " << partition->first << ", \"last\": " << partition->last << "}\n";
+                }
+                else if (op->string == "pass")
+                {
+                    if (!partition)
+                        throw std::runtime_error("pass before setup");
+                    const JsonValue *list = request.find("medoids");
+                    if (!list || !list->is_array())
+                        throw std::runtime_error("missing \"medoids\"");
+                    const size_t n = optimizer->get_points().size();
+                    std::vector<int> medoids;
+                    for (const JsonValue &m : list->array)
+                        medoids.push_back(integer(&m, "medoids", n));
+                    const SwapProposal best = optimizer->score_partition(*partition, medoids, *pool);
+                    out << "{\"ok\": true, \"candidate\": " << best.candidate << ", \"slot\": " << best.slot
+                        << ", \"delta\": " << best.delta << ", \"cost\": " << best.cost << "}\n";
+                }
+                else
+                {
+                    throw std::runtime_error("unknown op " + op->string + " (expected setup or pass)");
+                }
+            }
+            catch (const std::exception &e)
             {
-                continue;
+                out.str("");
+                out << "{\"ok\": false, \"error\": " << json_quote(e.what()) << "}\n";
             }
-
-            valid_candidates.push_back(i);
+            if (!send_all(fd, out.str()))
+                break;
         }
+    }
 
-        std::cout << "Valid candidates after filtering: " << valid_candidates.size() << std::endl;
+public:
+    PartitionWorker(int num_threads, std::string shared_token, bool verbose_output = true)
+        : threads(std::max(1, num_threads)), token(std::move(shared_token)), verbose(verbose_output)
+    {
     }
 
-    bool satisfies_min_distance(const std::vector<int> &medoids, int new_candidate)
+    // Serves coordinators until killed; false if the endpoint cannot be opened
+    bool run(const std::string &endpoint)
     {
-        for (int medoid_idx : medoids)
+        if (token.empty() && !is_loopback_endpoint(endpoint))
         {
-            double dist = get_distance(points[new_candidate].id, points[medoid_idx].id);
-            if (dist < min_distance_km * 1000)
-            { // Convert km to meters
-                return false;
-            }
+            std::cerr << "Error: Listening on " << endpoint << " beyond loopback needs --token; any peer that can"
+                      << " connect can make the worker read files" << std::endl;
+            return false;
         }
-        return true;
+        const int listen_fd = open_tcp(endpoint, true);
+        if (listen_fd < 0)
+            return false;
+        std::cout << "Worker listening on " << endpoint << " with " << threads << " threads" << std::endl;
+        const bool ok = serve(listen_fd, 0);
+        ::close(listen_fd);
+        return ok;
     }
 
-    double calculate_total_cost(const std::vector<int> &medoids)
+    // Serves sessions coordinators one after another on a listening socket,
+    // or forever when sessions is 0; false if accept fails
+    bool serve(int listen_fd, int sessions)
     {
-        double total_cost = 0.0;
-
-        for (int i = 0; i < points.size(); i++)
+        for (int served = 0; sessions == 0 || served < sessions;)
         {
-            double min_dist = std::numeric_limits<double>::max();
-
-            for (int medoid_idx : medoids)
+            const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0)
             {
-                double dist = get_distance(points[i].id, points[medoid_idx].id);
-                min_dist = std::min(min_dist, dist);
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+                return false;
             }
-
-            total_cost += min_dist * points[i].resource_quantity;
+            const int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (verbose)
+                std::cout << "Coordinator connected" << std::endl;
+            session(fd);
+            ::close(fd);
+            served++;
+            if (verbose)
+                std::cout << "Coordinator disconnected" << std::endl;
         }
-
-        return total_cost;
+        return true;
     }
+};
 
-    std::vector<int> get_assignments(const std::vector<int> &medoids)
-    {
-        std::vector<int> assignments(points.size());
+// Coordinator end of a distributed solve: one connection per worker, with
+// the requests of a round sent to every worker before any reply is read so
+// the workers score in parallel.
+class PartitionCoordinator
+{
+private:
+    std::vector<std::string> endpoints;
+    std::vector<int> fds;
+    std::vector<LineReader> readers;
+    std::string setup_fields; // Data files, constraints and options, as JSON members
+    const KMedoidsOptimizer &optimizer;
 
-        for (int i = 0; i < points.size(); i++)
+    // Sends requests[w] to worker w and parses every reply; false after
+    // reporting the first failure
+    bool round(const std::vector<std::string> &requests, std::vector<JsonValue> &replies)
+    {
+        for (size_t w = 0; w < fds.size(); w++)
         {
-            double min_dist = std::numeric_limits<double>::max();
-            int best_medoid = -1;
-
-            for (int j = 0; j < medoids.size(); j++)
+            if (!send_all(fds[w], requests[w]))
             {
-                double dist = get_distance(points[i].id, points[medoids[j]].id);
-                if (dist < min_dist)
-                {
-                    min_dist = dist;
-                    best_medoid = j;
-                }
+                std::cerr << "Error: Lost worker " << endpoints[w] << std::endl;
+                return false;
+            }
+        }
+        replies.resize(fds.size());
+        bool ok = true;
+        for (size_t w = 0; w < fds.size(); w++)
+        {
+            std::string line;
+            if (!readers[w].next(line))
+            {
+                std::cerr << "Error: Lost worker " << endpoints[w] << std::endl;
+                ok = false;
+                continue;
+            }
+            try
+            {
+                replies[w] = JsonParser(line).parse();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: Worker " << endpoints[w] << ": " << e.what() << std::endl;
+                ok = false;
+                continue;
+            }
+            const JsonValue *status = replies[w].find("ok");
+            if (!status || status->type != JsonValue::Type::Bool || !status->boolean)
+            {
+                const JsonValue *error = replies[w].find("error");
+                std::cerr << "Error: Worker " << endpoints[w] << ": "
+                          << ((error && error->is_string()) ? error->string : std::string("malformed reply")) << std::endl;
+                ok = false;
             }
-
-            assignments[i] = best_medoid;
         }
+        return ok;
+    }
 
-        return assignments;
+    static double number(const JsonValue &reply, const char *key)
+    {
+        const JsonValue *v = reply.find(key);
+        return (v && v->is_number()) ? v->number : -1.0;
     }
 
-    std::vector<int> initialize_medoids()
+public:
+    PartitionCoordinator(std::vector<std::string> worker_endpoints, std::string setup, const KMedoidsOptimizer &solver)
+        : endpoints(std::move(worker_endpoints)), setup_fields(std::move(setup)), optimizer(solver)
     {
-        std::vector<int> medoids;
-        std::vector<int> available_candidates = valid_candidates;
+    }
 
-        // First medoid: random selection
-        if (!available_candidates.empty())
+    ~PartitionCoordinator()
+    {
+        for (int fd : fds)
+            ::close(fd);
+    }
+
+    bool connect()
+    {
+        for (const std::string &endpoint : endpoints)
         {
-            std::uniform_int_distribution<int> dist(0, available_candidates.size() - 1);
-            int first_idx = dist(rng);
-            medoids.push_back(available_candidates[first_idx]);
+            const int fd = open_tcp(endpoint, false);
+            if (fd < 0)
+                return false;
+            fds.push_back(fd);
+            readers.emplace_back(fd);
         }
+        return true;
+    }
 
-        // Subsequent medoids: ensure minimum distance constraint
-        for (int i = 1; i < k && !available_candidates.empty(); i++)
+    PassScorer scorer()
+    {
+        PassScorer scorer;
+        scorer.begin = [this](size_t num_candidates)
         {
-            std::vector<int> valid_next;
-
-            for (int candidate_idx : available_candidates)
+            std::vector<std::string> requests;
+            for (size_t w = 0; w < fds.size(); w++)
+            {
+                requests.push_back("{\"op\": \"setup\", \"part\": " + std::to_string(w) + ", \"parts\": " +
+                                   std::to_string(fds.size()) + ", " + setup_fields + "}\n");
+            }
+            std::vector<JsonValue> replies;
+            if (!round(requests, replies))
+                return false;
+            const size_t num_points = optimizer.get_points().size();
+            for (size_t w = 0; w < fds.size(); w++)
             {
-                if (std::find(medoids.begin(), medoids.end(), candidate_idx) == medoids.end() &&
-                    satisfies_min_distance(medoids, candidate_idx))
+                if (number(replies[w], "num_points") != num_points || number(replies[w], "num_candidates") != num_candidates)
                 {
-                    valid_next.push_back(candidate_idx);
+                    std::cerr << "Error: Worker " << endpoints[w] << " loaded different data (" << number(replies[w], "num_points")
+                              << " points, " << number(replies[w], "num_candidates") << " candidates; expected "
+                              << num_points << " and " << num_candidates << ")" << std::endl;
+                    return false;
                 }
             }
+            return true;
+        };
+        scorer.score = [this](const std::vector<int> &medoids, SwapProposal &best)
+        {
+            std::string request = "{\"op\": \"pass\", \"medoids\": [";
+            for (size_t j = 0; j < medoids.size(); j++)
+                request += (j ? "," : "") + std::to_string(medoids[j]);
+            request += "]}\n";
+            const std::vector<std::string> requests(fds.size(), request);
+            std::vector<JsonValue> replies;
+            if (!round(requests, replies))
+                return false;
 
-            if (valid_next.empty())
+            // Shares are in candidate order, so the first of equal deltas is
+            // the earliest candidate
+            best = SwapProposal();
+            best.cost = number(replies[0], "cost");
+            for (const JsonValue &reply : replies)
             {
-                std::cout << "Warning: Cannot find " << k << " medoids satisfying distance constraint" << std::endl;
-                break;
+                const int candidate = static_cast<int>(number(reply, "candidate"));
+                const double delta = number(reply, "delta");
+                if (candidate >= 0 && (best.candidate < 0 || delta < best.delta))
+                {
+                    best.candidate = candidate;
+                    best.slot = static_cast<int>(number(reply, "slot"));
+                    best.delta = delta;
+                }
             }
+            return true;
+        };
+        return scorer;
+    }
+};
 
-            std::uniform_int_distribution<int> dist(0, valid_next.size() - 1);
-            medoids.push_back(valid_next[dist(rng)]);
+// Members of the setup request every worker gets: the data files, the
+// constraints, the options that change how distances are stored and the
+// shared --token
+std::string partition_setup(const std::string &resource_file, const std::string &zone_file, const std::string &road_file,
+                            int k, double min_distance_km, double max_slope, const std::set<std::string> &exclude_types,
+                            std::map<std::string, std::string> &options)
+{
+    std::ostringstream setup;
+    setup << std::setprecision(17) << "\"resource_file\": " << json_quote(resource_file)
+          << ", \"zone_file\": " << json_quote(zone_file) << ", \"road_file\": " << json_quote(road_file)
+          << ", \"k\": " << k << ", \"min_dist\": " << min_distance_km << ", \"max_slope\": " << max_slope
+          << ", \"exclude_types\": [";
+    for (auto it = exclude_types.begin(); it != exclude_types.end(); ++it)
+        setup << (it == exclude_types.begin() ? "" : ", ") << json_quote(*it);
+    setup << "], \"options\": {";
+    bool first = true;
+    for (const char *key : {"storage", "tile-cache", "distance-precision", "simd"})
+    {
+        if (options.count(key))
+        {
+            setup << (first ? "" : ", ") << json_quote(key) << ": " << json_quote(options[key]);
+            first = false;
         }
+    }
+    setup << "}";
+    if (options.count("token"))
+        setup << ", \"token\": " << json_quote(options["token"]);
+    return setup.str();
+}
 
-        return medoids;
+#ifndef CENTER_OPTIMIZER_NO_MAIN
+int main(int argc, char *argv[])
+{
+    // Split "--name value" options from the positional arguments
+    std::vector<std::string> args;
+    std::map<std::string, std::string> options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) == 0 && i + 1 < argc)
+        {
+            options[arg.substr(2)] = argv[++i];
+        }
+        else
+        {
+            args.push_back(arg);
+        }
     }
 
-    std::pair<std::vector<int>, double> optimize()
+    if (!args.empty() && args[0] == "convert")
     {
-        filter_candidates();
+        if (args.size() < 4)
+        {
+            std::cerr << "Usage: " << argv[0] << " convert <resource_points.csv> <road_network.csv> <output.bin>"
+                      << " [--distance-precision f64|f32|u16[:meters]]" << std::endl;
+            return 1;
+        }
 
-        if (valid_candidates.size() < k)
+        KMedoidsOptimizer converter(0, 0.0, {}, 0.0);
+        if (!configure_optimizer(converter, options))
         {
-            std::cout << "Error: Not enough valid candidates (" << valid_candidates.size() << ") for k=" << k << std::endl;
-            return {{}, std::numeric_limits<double>::max()};
+            return 1;
+        }
+        try
+        {
+            converter.load_points(args[1]);
+            converter.load_distances(args[2]);
         }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        if (!converter.save_distances_binary(args[3]))
+        {
+            return 1;
+        }
+        std::cout << "Wrote binary distance matrix to " << args[3] << std::endl;
+        return 0;
+    }
 
-        std::vector<int> best_medoids = initialize_medoids();
-        double best_cost = calculate_total_cost(best_medoids);
+    if (!args.empty() && args[0] == "bench")
+    {
+        return run_bench(options);
+    }
 
-        std::cout << "Initial cost: " << best_cost << std::endl;
+    if (!args.empty() && args[0] == "server")
+    {
+        // Request workers and threads per solve; the rest configures every load
+        const std::string socket_path = options.count("socket") ? options["socket"] : "center_optimizer.sock";
+        int workers = std::max(1u, std::thread::hardware_concurrency()), solve_threads = 1;
+        if ((options.count("threads") && !parse_number(options["threads"], "--threads", workers)) ||
+            (options.count("solve-threads") && !parse_number(options["solve-threads"], "--solve-threads", solve_threads)))
+            return 1;
+        for (const char *key : {"socket", "threads", "solve-threads", "stats"})
+            options.erase(key);
+        SolveServer server(options, workers, solve_threads);
+        return server.run(socket_path) ? 0 : 1;
+    }
 
-        bool improved = true;
-        int iterations = 0;
-        const int max_iterations = 50;
+    if (!args.empty() && args[0] == "worker")
+    {
+        int threads = 0;
+        if (options.count("threads") && !parse_number(options["threads"], "--threads", threads))
+            return 1;
+        PartitionWorker worker(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency()),
+                               options.count("token") ? options["token"] : "");
+        return worker.run(options.count("listen") ? options["listen"] : "127.0.0.1:7070") ? 0 : 1;
+    }
 
-        while (improved && iterations < max_iterations)
+    if (!args.empty() && args[0] == "batch")
+    {
+        if (args.size() < 5)
         {
-            improved = false;
-            iterations++;
+            std::cerr << "Usage: " << argv[0] << " batch <resource_points.csv> <zone_features.csv> <road_network.csv>"
+                      << " <scenarios.json|scenarios.csv> [--out batch_results.json] [options]" << std::endl;
+            return 1;
+        }
 
-            for (int i = 0; i < best_medoids.size(); i++)
-            {
-                for (int candidate_idx : valid_candidates)
-                {
-                    if (std::find(best_medoids.begin(), best_medoids.end(), candidate_idx) != best_medoids.end())
-                    {
-                        continue; // Already a medoid
-                    }
+        KMedoidsOptimizer optimizer(0, 0.0, {}, 0.0);
+        if (!configure_optimizer(optimizer, options))
+        {
+            return 1;
+        }
 
-                    // Create new medoid set with replacement
-                    std::vector<int> new_medoids = best_medoids;
-                    new_medoids[i] = candidate_idx;
+        std::vector<Scenario> scenarios;
+        try
+        {
+            optimizer.load_points(args[1]);
+            optimizer.load_zone_features(args[2]);
+            if (args[3] != "none")
+                optimizer.load_distances(args[3]);
+            scenarios = load_scenarios(args[4]);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
 
-                    // Check minimum distance constraint
-                    bool valid = true;
-                    for (int j = 0; j < new_medoids.size(); j++)
-                    {
-                        for (int l = j + 1; l < new_medoids.size(); l++)
-                        {
-                            double dist = get_distance(points[new_medoids[j]].id, points[new_medoids[l]].id);
-                            if (dist < min_distance_km * 1000)
-                            {
-                                valid = false;
-                                break;
-                            }
-                        }
-                        if (!valid)
-                            break;
-                    }
+        auto results = optimizer.optimize_batch(scenarios);
 
-                    if (!valid)
-                        continue;
+        // Build the whole document first so the file is written in one go
+        std::ostringstream document;
+        optimizer.write_batch_results(document, scenarios, results);
+        const std::string out_file = options.count("out") ? options["out"] : "batch_results.json";
+        std::ofstream out(out_file);
+        if (!out.is_open() || !(out << document.str()))
+        {
+            std::cerr << "Error: Cannot write " << out_file << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << scenarios.size() << " scenario results to " << out_file << std::endl;
+        return (options.count("stats") && !write_stats(optimizer, options["stats"])) ? 1 : 0;
+    }
 
-                    double new_cost = calculate_total_cost(new_medoids);
-                    if (new_cost < best_cost)
-                    {
-                        best_medoids = new_medoids;
-                        best_cost = new_cost;
-                        improved = true;
-                    }
-                }
-            }
+    if (args.size() < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <resource_points.csv> <zone_features.csv> <road_network.csv|none> <k> [min_distance_km] [exclude_land_types] [max_slope]"
+                  << " [--threads N] [--storage dense|candidates|tiled] [--tile-cache MB] [--init random|build|kmedoids++|lab]"
+                  << " [--algorithm pam|clara|clarans] [--samples R] [--sample-size S] [--max-neighbors M]"
+                  << " [--restarts R] [--seed S] [--initial-medoids ids|file] [--capacity units|zone]"
+                  << " [--simd auto|scalar|avx2|avx512] [--distance-precision f64|f32|u16[:meters]]"
+                  << " [--time-budget seconds] [--max-evals N] [--progress file|-] [--workers host:port,... [--token T]]"
+                  << " [--output text|json|binary] [--out file] [--stats file|-]" << std::endl;
+        std::cerr << "       " << argv[0] << " convert <resource_points.csv> <road_network.csv> <output.bin>"
+                  << " [--distance-precision f64|f32|u16[:meters]]" << std::endl;
+        std::cerr << "       " << argv[0] << " bench [--sizes N,...] [--k K,...] [--candidate-ratios R,...]"
+                  << " [--roads edges|dense|none] [--out bench_results.csv|json]" << std::endl;
+        std::cerr << "       " << argv[0] << " batch <resource_points.csv> <zone_features.csv> <road_network.csv> <scenarios.json|csv> [--out file]" << std::endl;
+        std::cerr << "       " << argv[0] << " server [--socket center_optimizer.sock] [--threads N] [--solve-threads N] [options]" << std::endl;
+        std::cerr << "       " << argv[0] << " worker [--listen 127.0.0.1:7070] [--token T] [--threads N]" << std::endl;
+        return 1;
+    }
 
-            if (improved)
-            {
-                std::cout << "Iteration " << iterations << ": cost = " << best_cost << std::endl;
-            }
+    std::string resource_file = args[0];
+    std::string zone_file = args[1];
+    std::string road_file = args[2];
+    int k = 0;
+    double min_distance_km = 2.0, max_slope = 30.0;
+    if (!parse_number(args[3], "k", k) || (args.size() > 4 && !parse_number(args[4], "minimum distance", min_distance_km)) ||
+        (args.size() > 6 && !parse_number(args[6], "maximum slope", max_slope)))
+    {
+        return 1;
+    }
+
+    std::set<std::string> exclude_types;
+    if (args.size() > 5 && args[5] != "none")
+    {
+        std::istringstream ss(args[5]);
+        std::string token;
+        while (std::getline(ss, token, ','))
+        {
+            exclude_types.insert(token);
         }
+    }
 
-        std::cout << "Converged after " << iterations << " iterations" << std::endl;
-        return {best_medoids, best_cost};
+    KMedoidsOptimizer optimizer(k, min_distance_km, exclude_types, max_slope);
+    if (!configure_optimizer(optimizer, options))
+    {
+        return 1;
     }
 
-    void print_results(const std::vector<int> &medoids, double total_cost)
+    auto format = KMedoidsOptimizer::OutputFormat::Text;
+    if (options.count("output"))
     {
-        std::cout << "\nBest Centers:" << std::endl;
-        for (int medoid_idx : medoids)
+        const std::string &output = options["output"];
+        if (output == "json")
+            format = KMedoidsOptimizer::OutputFormat::Json;
+        else if (output == "binary")
+            format = KMedoidsOptimizer::OutputFormat::Binary;
+        else if (output != "text")
         {
-            const Point &p = points[medoid_idx];
-            std::cout << p.id << "," << p.lat << "," << p.lon << ","
-                      << p.land_type << "," << p.slope << "," << p.elevation << std::endl;
+            std::cerr << "Error: Unknown output format " << output << " (expected text, json or binary)" << std::endl;
+            return 1;
         }
+    }
 
-        std::cout << "\nAssignments:" << std::endl;
-        std::vector<int> assignments = get_assignments(medoids);
-        for (int i = 0; i < points.size(); i++)
+    // Structured output on stdout must not be mixed with progress messages
+    std::ofstream out_file;
+    if (options.count("out"))
+    {
+        out_file.open(options["out"], std::ios::binary);
+        if (!out_file.is_open())
         {
-            std::cout << "Point: " << points[i].id << " -> Center: "
-                      << points[medoids[assignments[i]]].id << std::endl;
+            std::cerr << "Error: Cannot open " << options["out"] << std::endl;
+            return 1;
         }
-
-        std::cout << "\nTotal Cost: " << total_cost << std::endl;
     }
-};
+    else if (format != KMedoidsOptimizer::OutputFormat::Text)
+    {
+        optimizer.set_verbose(false);
+    }
+    std::ostream &out = out_file.is_open() ? out_file : std::cout;
 
-int main(int argc, char *argv[])
-{
-    if (argc < 5)
+    // Workers map the matrix rows they need, which a CSV matrix cannot offer
+    if (options.count("workers") && road_file != "none" && KMedoidsOptimizer::is_dense_csv_matrix(road_file))
     {
-        std::cerr << "Usage: " << argv[0] << " <resource_points.csv> <zone_features.csv> <road_network.csv> <k> [min_distance_km] [exclude_land_types] [max_slope]" << std::endl;
+        std::cerr << "Error: --workers needs a binary distance matrix or a road edge list; convert " << road_file
+                  << " first" << std::endl;
         return 1;
     }
 
-    std::string resource_file = argv[1];
-    std::string zone_file = argv[2];
-    std::string road_file = argv[3];
-    int k = std::stoi(argv[4]);
+    try
+    {
+        optimizer.load_points(resource_file);
+        optimizer.load_zone_features(zone_file);
+        if (road_file != "none") // Geo-only: Haversine distances with a spatial index
+            optimizer.load_distances(road_file);
+        if (options.count("initial-medoids"))
+            optimizer.set_initial_medoids(load_initial_medoids(options["initial-medoids"]));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
 
-    double min_distance_km = (argc > 5) ? std::stod(argv[5]) : 2.0;
-    std::set<std::string> exclude_types;
-    if (argc > 6 && std::string(argv[6]) != "none")
+    // Distributed: the workers score the swap passes, reading the data files
+    // at the same paths (relative ones from their working directory)
+    std::unique_ptr<PartitionCoordinator> coordinator;
+    if (options.count("workers"))
     {
-        std::string exclude_str = argv[6];
-        std::istringstream ss(exclude_str);
-        std::string token;
-        while (std::getline(ss, token, ','))
+        if (options.count("capacity") || (options.count("algorithm") && options["algorithm"] != "pam") ||
+            (options.count("restarts") && std::stoi(options["restarts"]) > 1))
         {
-            exclude_types.insert(token);
+            std::cerr << "Error: --workers supports --algorithm pam without --capacity or --restarts" << std::endl;
+            return 1;
+        }
+        std::vector<std::string> endpoints;
+        std::istringstream list(options["workers"]);
+        for (std::string endpoint; std::getline(list, endpoint, ',');)
+        {
+            if (!endpoint.empty())
+                endpoints.push_back(endpoint);
+        }
+        if (endpoints.empty())
+        {
+            std::cerr << "Error: --workers needs host:port[,host:port...]" << std::endl;
+            return 1;
         }
-    }
-    double max_slope = (argc > 7) ? std::stod(argv[7]) : 30.0;
 
-    KMedoidsOptimizer optimizer(k, min_distance_km, exclude_types, max_slope);
+        const std::string setup = partition_setup(resource_file, zone_file, road_file, k, min_distance_km, max_slope,
+                                                  exclude_types, options);
+        coordinator = std::make_unique<PartitionCoordinator>(endpoints, setup, optimizer);
+        if (!coordinator->connect())
+        {
+            return 1;
+        }
+        optimizer.set_pass_scorer(coordinator->scorer());
+    }
 
-    optimizer.load_points(resource_file);
-    optimizer.load_zone_features(zone_file);
-    optimizer.load_distances(road_file);
+    // One JSON line per improving solution, flushed as it is found
+    std::ofstream progress_file;
+    if (options.count("progress"))
+    {
+        if (options["progress"] != "-")
+        {
+            progress_file.open(options["progress"]);
+            if (!progress_file.is_open())
+            {
+                std::cerr << "Error: Cannot write " << options["progress"] << std::endl;
+                return 1;
+            }
+        }
+        std::ostream &progress = progress_file.is_open() ? progress_file : std::cerr;
+        optimizer.set_progress_callback([&](const std::vector<int> &centers, double total_cost, double seconds)
+        {
+            const std::vector<Point> &points = optimizer.get_points();
+            std::ostringstream line;
+            line << std::setprecision(15) << "{\"seconds\": " << seconds << ", \"total_cost\": " << total_cost << ", \"centers\": [";
+            for (size_t j = 0; j < centers.size(); j++)
+                line << (j ? "," : "") << points[centers[j]].id;
+            line << "]}\n";
+            progress << line.str() << std::flush;
+        });
+    }
 
     auto [medoids, cost] = optimizer.optimize();
 
     if (!medoids.empty())
     {
-        optimizer.print_results(medoids, cost);
+        optimizer.print_results(medoids, cost, format, out);
+        if (options.count("stats") && !write_stats(optimizer, options["stats"]))
+        {
+            return 1;
+        }
     }
     else
     {
@@ -465,4 +7235,5 @@ int main(int argc, char *argv[])
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
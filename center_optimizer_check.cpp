@@ -0,0 +1,1730 @@
+// Deterministic self-checks of center_optimizer.cpp, built as a separate
+// program so the checks stay out of the optimizer and the Python extension:
+//   g++ -std=c++17 -O3 -pthread -o center_optimizer_check center_optimizer_check.cpp
+//   ./center_optimizer_check [--data data] [--only name,...]
+#define CENTER_OPTIMIZER_NO_MAIN
+#include "center_optimizer.cpp"
+
+// Scratch space and fixture paths handed to every self-check
+struct CheckContext
+{
+    std::string data;
+    std::string dir;
+    std::vector<std::string> files;
+    std::vector<std::string> dirs;
+
+    std::string file(const std::string &name)
+    {
+        files.push_back(dir + "/" + name);
+        return files.back();
+    }
+
+    // Quiet optimizer over the fixture points, zones and road matrix
+    std::unique_ptr<KMedoidsOptimizer> fixture(int k, bool roads = true)
+    {
+        auto optimizer = std::make_unique<KMedoidsOptimizer>(k, 0.0, std::set<std::string>{}, 90.0);
+        optimizer->set_verbose(false);
+        optimizer->set_seed(42);
+        optimizer->load_points(data + "/resource_points.csv");
+        optimizer->load_zone_features(data + "/zone_features.csv");
+        if (roads)
+            optimizer->load_distances(data + "/road_network.csv");
+        return optimizer;
+    }
+
+    // Directory of a generated dataset of n points, written once per size
+    // and road format; wetland marks the points that are not candidates
+    std::string synthetic_dataset(size_t n, bool dense_roads)
+    {
+        const std::string path = dir + "/synthetic_" + std::to_string(n) + (dense_roads ? "_dense" : "_grid");
+        if (std::find(dirs.begin(), dirs.end(), path) == dirs.end())
+        {
+            if (::mkdir(path.c_str(), 0700) != 0)
+                throw std::runtime_error("cannot create " + path);
+            dirs.push_back(path);
+            for (const char *name : {"/resource_points.csv", "/zone_features.csv", "/road_network.csv"})
+                files.push_back(path + name);
+            write_synthetic_dataset(path, n, 0.5, dense_roads, 11);
+        }
+        return path;
+    }
+
+    // Quiet optimizer over synthetic_dataset(n, dense_roads)
+    std::unique_ptr<KMedoidsOptimizer> synthetic(int k, size_t n, bool dense_roads)
+    {
+        const std::string path = synthetic_dataset(n, dense_roads);
+        auto optimizer = std::make_unique<KMedoidsOptimizer>(k, 0.0, std::set<std::string>{"wetland"}, 90.0);
+        optimizer->set_verbose(false);
+        optimizer->set_seed(42);
+        optimizer->load_points(path + "/resource_points.csv");
+        optimizer->load_zone_features(path + "/zone_features.csv");
+        optimizer->load_distances(path + "/road_network.csv");
+        return optimizer;
+    }
+};
+
+// Silences std::cerr while a check provokes an expected error
+class QuietErrors
+{
+    NullBuffer sink;
+    std::streambuf *saved;
+
+public:
+    QuietErrors() : saved(std::cerr.rdbuf(&sink)) {}
+    ~QuietErrors() { std::cerr.rdbuf(saved); }
+};
+
+// A named deterministic check; returns an empty string or what failed
+struct SelfCheck
+{
+    const char *name;
+    std::function<std::string(CheckContext &)> run;
+};
+
+std::string check_csv_malformed(CheckContext &ctx)
+{
+    // The fixtures again with CRLF endings, padded fields, '+' signs, blank
+    // lines and no final newline; they must parse to the same data
+    auto messy_copy = [&](const std::string &name)
+    {
+        std::ifstream in(ctx.data + "/" + name);
+        const std::string path = ctx.file("messy_" + name);
+        std::ofstream out(path, std::ios::binary);
+        std::string line;
+        for (int row = 0; std::getline(in, line); row++)
+        {
+            if (row > 0)
+                out << (row % 7 == 0 ? "\r\n \r\n" : "\r\n");
+            std::string padded;
+            for (char c : line)
+                padded += c == ',' ? std::string(row % 2 ? " , " : ",\t") : std::string(1, c);
+            out << (row % 3 == 1 ? "+" : "") << padded;
+        }
+        return path;
+    };
+    auto clean = ctx.fixture(3);
+    KMedoidsOptimizer messy(3, 0.0, {}, 90.0);
+    messy.set_verbose(false);
+    messy.load_points(messy_copy("resource_points.csv"));
+    messy.load_zone_features(messy_copy("zone_features.csv"));
+    messy.load_distances(messy_copy("road_network.csv"));
+    const std::vector<Point> &a = clean->get_points(), &b = messy.get_points();
+    if (a.size() != b.size())
+        return "padded files loaded " + std::to_string(b.size()) + " points instead of " + std::to_string(a.size());
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].id != b[i].id || a[i].lat != b[i].lat || a[i].lon != b[i].lon || a[i].resource_quantity != b[i].resource_quantity ||
+            a[i].land_type != b[i].land_type || a[i].slope != b[i].slope || a[i].elevation != b[i].elevation)
+            return "padded files changed point " + std::to_string(a[i].id);
+        for (size_t j = 0; j < a.size(); j++)
+        {
+            if (clean->get_distance_idx(i, j) != messy.get_distance_idx(i, j))
+                return "padded files changed a distance";
+        }
+    }
+
+    // A malformed row must fail with its file and line
+    auto rejects = [&](const std::string &header, const std::string &bad_row, const std::string &expected,
+                       bool (KMedoidsOptimizer::*loader)(const std::string &))
+    {
+        const std::string path = ctx.file("malformed.csv");
+        std::ofstream(path) << header << "\n1,26.1,75.4,674\n" << bad_row << "\n";
+        KMedoidsOptimizer optimizer(3, 0.0, {}, 90.0);
+        optimizer.set_verbose(false);
+        if (loader != &KMedoidsOptimizer::load_points)
+            optimizer.load_points(ctx.data + "/resource_points.csv");
+        try
+        {
+            (optimizer.*loader)(path);
+        }
+        catch (const std::runtime_error &e)
+        {
+            return std::string(e.what()).find(path + ":3: " + expected) == 0;
+        }
+        return false;
+    };
+    const std::string points_header = "id,latitude,longitude,resource_quantity";
+    if (!rejects(points_header, "2,26.4,75.3", "expected 4 fields", &KMedoidsOptimizer::load_points))
+        return "a short row was not reported at its line";
+    if (!rejects(points_header, "2,26.4,east,963", "invalid number", &KMedoidsOptimizer::load_points))
+        return "a non-numeric coordinate was not reported at its line";
+    if (!rejects(points_header, "2x,26.4,75.3,963", "invalid integer", &KMedoidsOptimizer::load_points))
+        return "a malformed ID was not reported at its line";
+    if (!rejects("id,slope,elevation,land_type", "2,steep,410.6,wetland", "invalid number", &KMedoidsOptimizer::load_zone_features))
+        return "a malformed zone row was not reported at its line";
+    if (!rejects("from_point,p1,p2", "p2,8.5,--", "invalid number", &KMedoidsOptimizer::load_distances))
+        return "a malformed distance was not reported at its line";
+    return "";
+}
+
+std::string check_swap_optimum(CheckContext &ctx)
+{
+    // Incremental swap deltas must agree with full recomputation: the
+    // result is a local optimum that no feasible single swap improves
+    for (const double min_distance : {0.0, 4.0})
+    {
+        auto optimizer = ctx.fixture(4);
+        optimizer->set_constraints(4, min_distance, {"wetland"}, 25.0);
+        const std::pair<std::vector<int>, double> result = optimizer->optimize();
+        const double cost = optimizer->calculate_total_cost(result.first);
+        if (result.first.size() != 4 || std::abs(result.second - cost) > 1e-9 * cost)
+            return "the reported cost differs from the cost of the medoids";
+        for (size_t slot = 0; slot < result.first.size(); slot++)
+        {
+            std::vector<int> others = result.first;
+            others.erase(others.begin() + slot);
+            for (int candidate : optimizer->get_valid_candidates())
+            {
+                if (std::count(result.first.begin(), result.first.end(), candidate) ||
+                    !optimizer->satisfies_min_distance(others, candidate))
+                    continue;
+                std::vector<int> swapped = result.first;
+                swapped[slot] = candidate;
+                if (optimizer->calculate_total_cost(swapped) < cost * (1 - 1e-12))
+                    return "a single swap still improves the solution";
+            }
+        }
+    }
+    return "";
+}
+
+std::string check_threads(CheckContext &ctx)
+{
+    // Swap scoring splits candidates across threads; the chosen swap and
+    // so the solution must not depend on the split
+    for (const char *init : {"random", "build"})
+    {
+        std::pair<std::vector<int>, double> reference;
+        for (const char *threads : {"1", "3", "8"})
+        {
+            auto optimizer = ctx.synthetic(8, 400, true);
+            std::map<std::string, std::string> options{{"threads", threads}, {"init", init}};
+            if (!configure_optimizer(*optimizer, options))
+                return "invalid options";
+            const std::pair<std::vector<int>, double> result = optimizer->optimize();
+            if (result.first.size() != 8)
+                return std::string("--init ") + init + " chose " + std::to_string(result.first.size()) + " of 8 medoids";
+            if (reference.first.empty())
+                reference = result;
+            else if (result != reference)
+                return std::string("--init ") + init + " on " + threads + " threads differs from 1 thread";
+        }
+    }
+
+    // Malformed numbers are refused with an error, not an exception
+    const std::pair<const char *, const char *> malformed[] = {
+        {"threads", "abc"}, {"threads", "4x"}, {"seed", "-1"}, {"restarts", ""}, {"capacity", "1e400"}, {"samples", "3.5"}};
+    for (const auto &[name, value] : malformed)
+    {
+        auto optimizer = ctx.fixture(3, false);
+        std::map<std::string, std::string> options{{name, value}};
+        QuietErrors quiet;
+        if (configure_optimizer(*optimizer, options))
+            return std::string("accepted --") + name + " " + value;
+    }
+    return "";
+}
+
+std::string check_road_graph(CheckContext &ctx)
+{
+    // Random two-way roads between points 1-12 and junctions 1001-1004;
+    // on-demand Dijkstra rows must equal Floyd-Warshall over the same edges
+    std::vector<int> nodes;
+    for (int id = 1; id <= 12; id++)
+        nodes.push_back(id);
+    for (int id = 1001; id <= 1004; id++)
+        nodes.push_back(id);
+    const size_t m = nodes.size();
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> expected(m * m, inf);
+    for (size_t a = 0; a < m; a++)
+        expected[a * m + a] = 0.0;
+
+    const std::string path = ctx.file("edges.csv");
+    std::ofstream edges(path);
+    edges << "From_ID,To_ID,Distance\n";
+    std::mt19937 gen(7);
+    for (int e = 0; e < 30; e++)
+    {
+        const size_t a = gen() % m, b = gen() % m;
+        const double length = 500 + gen() % 20000;
+        edges << nodes[a] << "," << nodes[b] << "," << length << "\n";
+        expected[a * m + b] = expected[b * m + a] = std::min(expected[a * m + b], length);
+    }
+    edges.close();
+    for (size_t via = 0; via < m; via++)
+        for (size_t a = 0; a < m; a++)
+            for (size_t b = 0; b < m; b++)
+                expected[a * m + b] = std::min(expected[a * m + b], expected[a * m + via] + expected[via * m + b]);
+
+    auto optimizer = ctx.fixture(3, false);
+    optimizer->load_distances(path);
+    const std::vector<Point> &points = optimizer->get_points();
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        for (size_t j = 0; j < points.size(); j++)
+        {
+            const auto a = std::find(nodes.begin(), nodes.end(), points[i].id) - nodes.begin();
+            const auto b = std::find(nodes.begin(), nodes.end(), points[j].id) - nodes.begin();
+            double want = (a < 12 && b < 12) ? expected[a * m + b] : inf;
+            if (want == inf) // Not connected: straight-line fallback
+                want = KMedoidsOptimizer::haversine_distance(points[i].lat, points[i].lon, points[j].lat, points[j].lon);
+            if (std::abs(optimizer->get_distance_idx(i, j) - want) > 1e-6)
+                return "distance " + std::to_string(points[i].id) + " -> " + std::to_string(points[j].id) + " is " +
+                       std::to_string(optimizer->get_distance_idx(i, j)) + ", expected " + std::to_string(want);
+        }
+    }
+    const std::pair<std::vector<int>, double> result = optimizer->optimize();
+    if (result.first.size() != 3 || std::abs(result.second - optimizer->calculate_total_cost(result.first)) > 1e-9 * result.second)
+        return "a solve over the road graph reports an inconsistent cost";
+    return "";
+}
+
+std::string check_candidate_storage(CheckContext &ctx)
+{
+    auto solve = [](KMedoidsOptimizer &optimizer, const char *storage)
+    {
+        std::map<std::string, std::string> options{{"storage", storage}};
+        configure_optimizer(optimizer, options);
+        optimizer.set_constraints(6, 2.0, {"wetland"}, 25.0);
+        optimizer.set_seed(42); // Same random start on every solve
+        return optimizer.optimize();
+    };
+    auto dense = ctx.synthetic(6, 400, true);
+    auto rows = ctx.synthetic(6, 400, true);
+    const std::pair<std::vector<int>, double> expected = solve(*dense, "dense");
+    if (expected.first.size() != 6 || solve(*rows, "candidates") != expected)
+        return "candidate rows and the dense matrix give different solutions";
+
+    // New distances on the same optimizer must replace the candidate rows
+    auto fresh = ctx.synthetic(6, 400, false);
+    rows->load_distances(ctx.synthetic_dataset(400, false) + "/road_network.csv");
+    if (solve(*rows, "candidates") != solve(*fresh, "dense"))
+        return "candidate rows were not rebuilt after the distances changed";
+    return "";
+}
+
+std::string check_min_distance(CheckContext &ctx)
+{
+    // The fixture matrix scaled by upper above the diagonal and by lower
+    // below it, so many pairs are too close in one direction only
+    auto fixture = ctx.fixture(3);
+    const size_t n = fixture->get_points().size();
+    auto write_scaled = [&](const std::string &name, double upper, double lower)
+    {
+        const std::string path = ctx.file(name);
+        std::ofstream out(path);
+        out << std::setprecision(17) << "from_point";
+        for (size_t c = 0; c < n; c++)
+            out << ",p" << c + 1;
+        for (size_t r = 0; r < n; r++)
+        {
+            out << "\np" << r + 1;
+            for (size_t c = 0; c < n; c++)
+                out << "," << fixture->get_distance_idx(c, r) / 1000 * (c > r ? upper : lower);
+        }
+        out << "\n";
+        return path;
+    };
+    auto feasible = [](const KMedoidsOptimizer &optimizer, const std::vector<int> &medoids, double min_distance_km)
+    {
+        for (int a : medoids)
+            for (int b : medoids)
+                if (a != b && optimizer.get_distance_idx(a, b) < min_distance_km * 1000)
+                    return false;
+        return true;
+    };
+
+    const std::string asymmetric = write_scaled("asymmetric.csv", 1.0, 0.5);
+    for (const double min_distance : {3.0, 5.0})
+    {
+        auto optimizer = ctx.fixture(4, false);
+        optimizer->load_distances(asymmetric);
+        optimizer->set_constraints(4, min_distance, {}, 90.0);
+        const std::vector<int> medoids = optimizer->optimize().first;
+        if (medoids.size() != 4 || !feasible(*optimizer, medoids, min_distance))
+            return "medoids closer than the minimum distance in one direction";
+    }
+
+    // Shorter distances after a reload must rebuild the conflict graph
+    auto optimizer = ctx.fixture(4, false);
+    optimizer->load_distances(write_scaled("far.csv", 3.0, 3.0));
+    optimizer->set_constraints(4, 6.0, {}, 90.0);
+    optimizer->optimize();
+    optimizer->load_distances(ctx.data + "/road_network.csv");
+    const std::vector<int> medoids = optimizer->optimize().first;
+    if (medoids.size() != 4 || !feasible(*optimizer, medoids, 6.0))
+        return "the conflict graph kept the distances loaded before";
+    return "";
+}
+
+std::string check_sampling(CheckContext &ctx)
+{
+    // Sampled searches must return feasible medoids with their full-data
+    // cost, independent of the thread count
+    for (const char *algorithm : {"clara", "clarans"})
+    {
+        std::pair<std::vector<int>, double> reference;
+        for (const char *threads : {"1", "4"})
+        {
+            auto optimizer = ctx.synthetic(6, 400, true);
+            std::map<std::string, std::string> options{{"algorithm", algorithm}, {"threads", threads}, {"samples", "3"}};
+            if (!configure_optimizer(*optimizer, options))
+                return "invalid options";
+            optimizer->set_constraints(6, 3.0, {"wetland"}, 25.0);
+            const std::pair<std::vector<int>, double> result = optimizer->optimize();
+            const std::string name = std::string(algorithm) + " on " + threads + " threads";
+            if (result.first.size() != 6)
+                return name + " chose " + std::to_string(result.first.size()) + " of 6 medoids";
+            const double cost = optimizer->calculate_total_cost(result.first);
+            if (std::abs(result.second - cost) > 1e-9 * cost)
+                return name + " reports a cost other than its full-data cost";
+            const std::vector<int> &candidates = optimizer->get_valid_candidates();
+            for (int a : result.first)
+            {
+                if (!std::binary_search(candidates.begin(), candidates.end(), a))
+                    return name + " chose a filtered point";
+                for (int b : result.first)
+                {
+                    if (a != b && optimizer->get_distance_idx(a, b) < 3000)
+                        return name + " broke the minimum distance";
+                }
+            }
+            if (reference.first.empty())
+                reference = result;
+            else if (result != reference)
+                return name + " differs from 1 thread";
+        }
+    }
+
+    // A later configure without sampling options keeps the earlier ones
+    auto solve = [&](bool reconfigure)
+    {
+        auto optimizer = ctx.synthetic(6, 400, true);
+        std::map<std::string, std::string> options{{"algorithm", "clara"}, {"sample-size", "30"}}, later{{"threads", "2"}};
+        configure_optimizer(*optimizer, options);
+        if (reconfigure)
+            configure_optimizer(*optimizer, later);
+        return optimizer->optimize();
+    };
+    if (solve(true) != solve(false))
+        return "a second configure dropped the sample size";
+    return "";
+}
+
+std::string check_restarts(CheckContext &ctx)
+{
+    // Restart r is seeded from (seed, r) alone, so more restarts only add
+    // runs and the thread count never matters
+    auto solve = [&](const char *restarts, const char *threads, const char *seed)
+    {
+        auto optimizer = ctx.synthetic(8, 400, true);
+        std::map<std::string, std::string> options{{"restarts", restarts}, {"threads", threads}, {"seed", seed}};
+        configure_optimizer(*optimizer, options);
+        return optimizer->optimize();
+    };
+    for (const char *seed : {"1", "2", "3", "4", "5", "6"})
+    {
+        const std::pair<std::vector<int>, double> five = solve("5", "1", seed);
+        if (five.first.size() != 8)
+            return "restarts chose " + std::to_string(five.first.size()) + " of 8 medoids";
+        if (solve("5", "2", seed) != five || solve("5", "5", seed) != five)
+            return "the best restart depends on the thread count";
+        if (solve("2", "3", seed).second < five.second)
+            return "two restarts beat five that include them";
+    }
+    return "";
+}
+
+std::string check_batch(CheckContext &ctx)
+{
+    // The same scenarios as CSV and JSON; the last one has too few candidates
+    const std::string csv = ctx.file("scenarios.csv"), json = ctx.file("scenarios.json");
+    std::ofstream(csv) << "name,num_centers,min_dist,exclude_types,max_slope\n"
+                       << "a,4,2,wetland,25\nb,7,0,wetland;forest,15\nc,5,4.5,wetland,30\nd,300,2,wetland,25\n";
+    std::ofstream(json) << "{\"scenarios\": [\n"
+                        << "{\"name\": \"a\", \"num_centers\": 4, \"min_dist\": 2, \"exclude_types\": \"wetland\", \"max_slope\": 25},\n"
+                        << "{\"name\": \"b\", \"k\": 7, \"min_dist\": 0, \"exclude_types\": [\"wetland\", \"forest\"], \"max_slope\": 15},\n"
+                        << "{\"name\": \"c\", \"num_centers\": 5, \"min_dist\": 4.5, \"exclude_types\": [\"wetland\"], \"max_slope\": 30},\n"
+                        << "{\"name\": \"d\", \"num_centers\": 300, \"min_dist\": 2, \"exclude_types\": \"wetland\", \"max_slope\": 25}]}\n";
+    const std::vector<Scenario> scenarios = load_scenarios(csv), from_json = load_scenarios(json);
+    if (scenarios.size() != 4 || from_json.size() != 4)
+        return "expected 4 scenarios in each file";
+    for (size_t i = 0; i < scenarios.size(); i++)
+    {
+        const Scenario &a = scenarios[i], &b = from_json[i];
+        if (a.name != b.name || a.k != b.k || a.min_distance_km != b.min_distance_km ||
+            a.exclude_land_types != b.exclude_land_types || a.max_slope != b.max_slope)
+            return "CSV and JSON scenario " + a.name + " differ";
+    }
+
+    // Concurrent scenarios must match separate runs of each
+    auto batch = ctx.synthetic(1, 400, true);
+    batch->set_num_threads(4);
+    const std::vector<std::pair<std::vector<int>, double>> results = batch->optimize_batch(scenarios);
+    std::ostringstream document;
+    batch->write_batch_results(document, scenarios, results);
+    const JsonValue written = JsonParser(document.str()).parse();
+    const JsonValue *listed = written.find("scenarios");
+    if (!listed || listed->array.size() != scenarios.size())
+        return "the results document does not list every scenario";
+    for (size_t i = 0; i < scenarios.size(); i++)
+    {
+        auto single = ctx.synthetic(1, 400, true);
+        single->set_constraints(scenarios[i].k, scenarios[i].min_distance_km, scenarios[i].exclude_land_types, scenarios[i].max_slope);
+        if (results[i] != single->optimize())
+            return "batch scenario " + scenarios[i].name + " differs from a separate run";
+        const JsonValue *success = listed->array[i].find("success");
+        if (!success || success->boolean != !results[i].first.empty())
+            return "the results document misreports scenario " + scenarios[i].name;
+    }
+    if (!results.back().first.empty() || results.front().first.empty())
+        return "scenario d should fail and scenario a succeed";
+    return "";
+}
+
+std::string check_warm_start(CheckContext &ctx)
+{
+    auto cold = ctx.synthetic(6, 400, true);
+    cold->set_constraints(6, 2.0, {"wetland"}, 25.0);
+    const std::pair<std::vector<int>, double> solved = cold->optimize();
+    if (solved.first.size() != 6)
+        return "the cold solve chose " + std::to_string(solved.first.size()) + " of 6 medoids";
+    const std::vector<Point> &points = cold->get_points();
+    std::vector<int> ids;
+    for (int m : solved.first)
+        ids.push_back(points[m].id);
+    auto sorted = [](std::vector<int> v) { std::sort(v.begin(), v.end()); return v; };
+
+    // Each saved form of the solution reads back as the same IDs
+    const std::string text = ctx.file("solution.txt"), json = ctx.file("solution.json");
+    {
+        std::ofstream out(text);
+        cold->print_results(solved.first, solved.second, KMedoidsOptimizer::OutputFormat::Text, out);
+    }
+    {
+        std::ofstream out(json);
+        cold->write_batch_results(out, {Scenario()}, {solved});
+    }
+    std::string list;
+    for (int id : ids)
+        list += (list.empty() ? "" : ",") + std::to_string(id);
+    for (const std::string &source : {list, text, json})
+    {
+        if (sorted(load_initial_medoids(source)) != sorted(ids))
+            return "the medoids read from " + (source == list ? "an ID list" : source) + " differ";
+    }
+
+    // A warm start from the optimum under another seed starts there, so
+    // a search cut off after one evaluation still returns it. Unknown,
+    // filtered or duplicate IDs are dropped and refilled.
+    auto warm = ctx.synthetic(6, 400, true);
+    warm->set_constraints(6, 2.0, {"wetland"}, 25.0);
+    warm->set_seed(7);
+    warm->set_search_budget(0.0, 1);
+    warm->set_initial_medoids(ids);
+    const std::pair<std::vector<int>, double> resumed = warm->optimize();
+    if (sorted(resumed.first) != sorted(solved.first) || std::abs(resumed.second - solved.second) > 1e-9 * solved.second)
+        return "a warm start did not begin from the given solution";
+
+    int filtered = -1;
+    for (const Point &p : points)
+        if (p.land_type == "wetland")
+            filtered = p.id;
+    auto partial = ctx.synthetic(6, 400, true);
+    partial->set_constraints(6, 2.0, {"wetland"}, 25.0);
+    partial->set_initial_medoids({ids[0], 999999, filtered, ids[0], ids[1]});
+    const std::pair<std::vector<int>, double> refilled = partial->optimize();
+    const std::vector<int> &candidates = partial->get_valid_candidates();
+    if (refilled.first.size() != 6 || std::set<int>(refilled.first.begin(), refilled.first.end()).size() != 6)
+        return "a partial warm start did not fill 6 distinct medoids";
+    for (int m : refilled.first)
+        if (!std::binary_search(candidates.begin(), candidates.end(), m))
+            return "a warm start kept a filtered point";
+    return "";
+}
+
+std::string check_live_updates(CheckContext &ctx)
+{
+    auto optimizer = ctx.synthetic(6, 400, true);
+    optimizer->set_constraints(6, 2.0, {"wetland"}, 25.0);
+    const std::pair<std::vector<int>, double> solved = optimizer->optimize();
+    if (solved.first.size() != 6 || !optimizer->track_solution(solved.first, 1e9)) // No refinement yet
+        return "cannot track the solution";
+
+    // Random quantity changes, removals and insertions, with the demand
+    // kept here for a from-scratch cost
+    std::vector<Point> demand = optimizer->get_points();
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (int step = 0; step < 300; step++)
+    {
+        const int op = gen() % 4;
+        const size_t pick = gen() % demand.size();
+        Point &p = demand[pick];
+        if (p.id < 0)
+            continue; // An inserted point removed before
+        if (op == 0 || op == 1)
+            p.resource_quantity = std::round(unit(gen) * 1000);
+        else if (op == 2)
+            p.resource_quantity = 0.0;
+        if (op < 3 && !(op == 2 ? optimizer->remove_point(p.id) : optimizer->update_quantity(p.id, p.resource_quantity)))
+            return "an update of point " + std::to_string(p.id) + " was refused";
+        if (op == 2 && pick >= optimizer->get_points().size())
+            p.id = -1; // Removing an inserted point forgets its ID
+        if (op == 3)
+        {
+            Point added;
+            added.id = 100000 + step;
+            added.lat = 25.7 + unit(gen);
+            added.lon = 74.9 + unit(gen);
+            added.resource_quantity = std::round(unit(gen) * 1000);
+            if (!optimizer->add_point(added))
+                return "an insertion was refused";
+            demand.push_back(added);
+        }
+    }
+    if (optimizer->add_point(optimizer->get_points()[0]) || optimizer->update_quantity(999999, 1.0))
+        return "a duplicate insertion or an unknown ID was accepted";
+
+    auto expected_cost = [&](const std::vector<int> &medoids)
+    {
+        const std::vector<Point> &loaded = optimizer->get_points();
+        double total = 0.0;
+        for (size_t i = 0; i < demand.size(); i++)
+        {
+            double nearest = std::numeric_limits<double>::max();
+            for (int m : medoids)
+                nearest = std::min(nearest, i < loaded.size() ? optimizer->get_distance_idx(i, m)
+                                                              : KMedoidsOptimizer::haversine_distance(demand[i].lat, demand[i].lon,
+                                                                                                      loaded[m].lat, loaded[m].lon));
+            total += demand[i].resource_quantity * nearest;
+        }
+        return total;
+    };
+    double expected = expected_cost(optimizer->live_medoids());
+    if (std::abs(optimizer->live_cost() - expected) > 1e-6 * expected)
+        return "the incremental cost drifted from the recomputed cost";
+
+    // Refinement only accepts improving swaps
+    optimizer->refine_live_solution();
+    const double refined = expected_cost(optimizer->live_medoids());
+    if (std::abs(optimizer->live_cost() - refined) > 1e-6 * refined || refined > expected * (1 + 1e-9))
+        return "refining the live solution did not keep or lower its cost";
+    return "";
+}
+
+std::string check_output_formats(CheckContext &ctx)
+{
+    // JSON and binary results must carry the same solution as the optimizer
+    auto optimizer = ctx.synthetic(5, 400, true);
+    const std::pair<std::vector<int>, double> solved = optimizer->optimize();
+    const std::vector<Point> &points = optimizer->get_points();
+    const std::vector<int> slots = optimizer->get_assignments(solved.first);
+    const size_t n = points.size(), k = solved.first.size();
+    if (k != 5)
+        return "the solve chose " + std::to_string(k) + " of 5 medoids";
+
+    std::ostringstream json_out, binary_out;
+    optimizer->print_results(solved.first, solved.second, KMedoidsOptimizer::OutputFormat::Json, json_out);
+    optimizer->print_results(solved.first, solved.second, KMedoidsOptimizer::OutputFormat::Binary, binary_out);
+    const JsonValue json = JsonParser(json_out.str()).parse();
+    const JsonValue *cost = json.find("total_cost"), *centers = json.find("centers");
+    const JsonValue *point_ids = json.find("point_ids"), *assigned = json.find("assignments");
+    if (!cost || !centers || !point_ids || !assigned || centers->array.size() != k || point_ids->array.size() != n ||
+        assigned->array.size() != n)
+        return "the JSON result is missing members";
+    if (std::abs(cost->number - solved.second) > 1e-12 * solved.second)
+        return "the JSON total cost differs";
+    double load = 0.0, total = 0.0;
+    int counted = 0;
+    for (size_t j = 0; j < k; j++)
+    {
+        if (centers->array[j].find("id")->number != points[solved.first[j]].id)
+            return "the JSON centers differ";
+        load += centers->array[j].find("load")->number;
+        counted += static_cast<int>(centers->array[j].find("num_points")->number);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        total += points[i].resource_quantity;
+        if (point_ids->array[i].number != points[i].id || assigned->array[i].number != points[solved.first[slots[i]]].id)
+            return "the JSON assignments differ";
+    }
+    if (counted != static_cast<int>(n) || std::abs(load - total) > 1e-9 * total)
+        return "the JSON center loads do not add up";
+
+    const std::string binary = binary_out.str();
+    BinaryResultHeader header;
+    if (binary.size() != sizeof(header) + k * (sizeof(int32_t) + sizeof(double)) + n * 2 * sizeof(int32_t))
+        return "the binary result has the wrong size";
+    std::memcpy(&header, binary.data(), sizeof(header));
+    if (std::memcmp(header.magic, binary_result_magic, sizeof(header.magic)) != 0 || header.version != 1 || header.k != k ||
+        header.n != n || header.total_cost != solved.second)
+        return "the binary header differs";
+    const char *cursor = binary.data() + sizeof(header);
+    auto next_int = [&]
+    {
+        int32_t value;
+        std::memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return value;
+    };
+    for (size_t j = 0; j < k; j++)
+        if (next_int() != points[solved.first[j]].id)
+            return "the binary centers differ";
+    cursor += k * sizeof(double);
+    for (size_t i = 0; i < n; i++)
+        if (next_int() != points[i].id)
+            return "the binary point IDs differ";
+    for (size_t i = 0; i < n; i++)
+        if (next_int() != slots[i])
+            return "the binary assignments differ";
+    return "";
+}
+
+std::string check_synthetic_data(CheckContext &ctx)
+{
+    // The generator is deterministic per seed, honours the candidate ratio
+    // and its grid roads connect every point
+    const std::string again = ctx.dir + "/synthetic_again";
+    if (::mkdir(again.c_str(), 0700) != 0)
+        return "cannot create " + again;
+    ctx.dirs.push_back(again);
+    for (const char *name : {"/resource_points.csv", "/zone_features.csv", "/road_network.csv"})
+        ctx.files.push_back(again + name);
+    write_synthetic_dataset(again, 400, 0.5, false, 11);
+    const std::string first = ctx.synthetic_dataset(400, false);
+    for (const char *name : {"/resource_points.csv", "/zone_features.csv", "/road_network.csv"})
+    {
+        std::ifstream a(first + name), b(again + name);
+        std::stringstream text_a, text_b;
+        text_a << a.rdbuf();
+        text_b << b.rdbuf();
+        if (text_a.str().empty() || text_a.str() != text_b.str())
+            return std::string("the same seed wrote a different ") + (name + 1);
+    }
+
+    auto optimizer = ctx.synthetic(4, 400, false);
+    optimizer->filter_candidates();
+    const size_t candidates = optimizer->get_valid_candidates().size();
+    if (candidates < 150 || candidates > 250)
+        return std::to_string(candidates) + " of 400 points are candidates at ratio 0.5";
+    const std::vector<Point> &points = optimizer->get_points();
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const double road = optimizer->get_distance_idx(i, 0);
+        const double straight = KMedoidsOptimizer::haversine_distance(points[i].lat, points[i].lon, points[0].lat, points[0].lon);
+        if (road < 1.3 * straight - 1.0 || road > 3 * straight + 1000) // Haversine fallback is shorter
+        {
+            return "point " + std::to_string(points[i].id) + " is not connected by the grid roads";
+        }
+    }
+    return "";
+}
+
+std::string check_stats(CheckContext &ctx)
+{
+    // Instrumentation must not change the result, and its counters must
+    // reflect the run: no fallbacks on a complete matrix, pruning under a
+    // wide minimum distance, and one accepted swap per iteration until
+    // the last finds none
+    auto solve = [&](bool with_stats, bool roads)
+    {
+        auto optimizer = ctx.synthetic(6, 400, true);
+        if (!roads)
+            optimizer->set_points(std::vector<Point>(optimizer->get_points())); // Drops the matrix
+        if (with_stats)
+            optimizer->enable_stats();
+        optimizer->set_constraints(6, 15.0, {"wetland"}, 25.0);
+        const std::pair<std::vector<int>, double> result = optimizer->optimize();
+        std::ostringstream json;
+        if (with_stats)
+            optimizer->get_stats()->write_json(json);
+        return std::make_pair(result, json.str());
+    };
+    const auto plain = solve(false, true), counted = solve(true, true);
+    if (plain.first != counted.first)
+        return "enabling stats changed the solution";
+    const JsonValue stats = JsonParser(counted.second).parse();
+    auto counter = [&](const JsonValue &root, const char *name)
+    {
+        const JsonValue *v = root.find(name);
+        return v ? v->number : -1.0;
+    };
+    const JsonValue *phases = stats.find("phases"), *accepted = stats.find("accepted_swaps_per_iteration");
+    if (!phases || phases->array.empty() || !accepted || accepted->array.size() != 1 || accepted->array[0].array.empty())
+        return "the stats lack phases or the swap search";
+    const std::vector<JsonValue> &iterations = accepted->array[0].array;
+    for (size_t i = 0; i < iterations.size(); i++)
+    {
+        if (iterations[i].number != (i + 1 < iterations.size() ? 1 : 0))
+            return "the accepted swaps per iteration do not match a converged search";
+    }
+    if (counter(stats, "swaps_evaluated") <= 0 || counter(stats, "swaps_pruned") <= 0 || counter(stats, "haversine_fallbacks") != 0)
+        return "the swap or distance counters do not match the run";
+
+    const JsonValue geo = JsonParser(solve(true, false).second).parse();
+    if (counter(geo, "haversine_fallbacks") <= 0)
+        return "a run without road distances counted no Haversine fallbacks";
+    return "";
+}
+
+std::string check_terrain_filter(CheckContext &ctx)
+{
+    // The interned land codes and slope column must filter exactly like
+    // the land type strings and slopes of the points
+    auto optimizer = ctx.synthetic(3, 400, false);
+    const std::vector<Point> &points = optimizer->get_points();
+    const std::vector<std::set<std::string>> exclusions = {
+        {}, {"wetland"}, {"wetland", "forest"}, {"barren", "unknown"}, {"agricultural", "barren", "forest", "wetland"}};
+    for (const std::set<std::string> &excluded : exclusions)
+    {
+        for (const double max_slope : {5.0, 19.5, 90.0})
+        {
+            optimizer->set_constraints(3, 0.0, excluded, max_slope);
+            optimizer->filter_candidates();
+            std::vector<int> expected;
+            for (size_t i = 0; i < points.size(); i++)
+            {
+                if (!excluded.count(points[i].land_type) && points[i].slope <= max_slope)
+                    expected.push_back(i);
+            }
+            if (optimizer->get_valid_candidates() != expected)
+                return "the candidate filter differs from the point attributes at slope " + std::to_string(max_slope);
+        }
+    }
+    return "";
+}
+
+std::string check_capacity(CheckContext &ctx)
+{
+    // The flow must match an exact dynamic program over the slot loads on
+    // small integer instances, both solved from scratch and after the
+    // center replacements the swap search makes
+    const int k = 3, n = 10, pool = 6;
+    const double penalty = 1000.0;
+    std::mt19937 gen(7);
+    for (int instance = 0; instance < 20; instance++)
+    {
+        std::vector<double> weights(n);
+        for (double &w : weights)
+            w = gen() % 5; // Some points carry no quantity
+        std::vector<std::vector<double>> rows(pool, std::vector<double>(n));
+        std::vector<double> capacities(pool);
+        for (int c = 0; c < pool; c++)
+        {
+            for (double &d : rows[c])
+                d = gen() % 100;
+            capacities[c] = 2 + gen() % 7;
+        }
+
+        // best[state]: cheapest cost of the points so far at slot loads
+        // state = l0 + 9 l1 + 81 l2; the rest overflows at the penalty
+        auto exact = [&](const std::vector<int> &centers)
+        {
+            const double inf = std::numeric_limits<double>::infinity();
+            std::vector<double> best(9 * 9 * 9, inf);
+            best[0] = 0.0;
+            for (int i = 0; i < n; i++)
+            {
+                const int w = weights[i];
+                std::vector<double> next(best.size(), inf);
+                for (int state = 0; state < best.size(); state++)
+                {
+                    if (best[state] == inf)
+                        continue;
+                    const int load[3] = {state % 9, state / 9 % 9, state / 81};
+                    for (int a = 0; a <= w; a++)
+                        for (int b = 0; a + b <= w; b++)
+                            for (int c = 0; a + b + c <= w; c++)
+                            {
+                                const int amount[3] = {a, b, c};
+                                bool fits = true;
+                                double cost = best[state] + (w - a - b - c) * penalty;
+                                for (int j = 0; j < k; j++)
+                                {
+                                    fits = fits && load[j] + amount[j] <= capacities[centers[j]];
+                                    cost += amount[j] * rows[centers[j]][i];
+                                }
+                                const int to = state + a + 9 * b + 81 * c;
+                                if (fits && cost < next[to])
+                                    next[to] = cost;
+                            }
+                }
+                best.swap(next);
+            }
+            return *std::min_element(best.begin(), best.end());
+        };
+
+        std::vector<int> centers = {0, 1, 2};
+        CapacitatedAssignment flow;
+        flow.reset(n, weights.data(), k, penalty);
+        for (int j = 0; j < k; j++)
+            flow.set_center(j, rows[centers[j]].data(), capacities[centers[j]]);
+        for (int swap = 0; swap < 6; swap++)
+        {
+            flow.solve();
+            if (std::abs(flow.cost() - exact(centers)) > 1e-6)
+                return "the flow cost of instance " + std::to_string(instance) + " after " + std::to_string(swap) +
+                       " swaps is not optimal";
+
+            // Replace a slot's center with one outside the current set
+            int replacement = gen() % pool;
+            while (std::find(centers.begin(), centers.end(), replacement) != centers.end())
+                replacement = (replacement + 1) % pool;
+            const int slot = gen() % k;
+            centers[slot] = replacement;
+            flow.set_center(slot, rows[replacement].data(), capacities[replacement]);
+        }
+    }
+
+    // A capacity nothing reaches must not change the solve, and a binding
+    // one must not depend on the thread count
+    auto plain = ctx.synthetic(5, 400, true);
+    const auto expected = plain->optimize();
+    double total = 0.0;
+    for (const Point &p : plain->get_points())
+        total += p.resource_quantity;
+    auto loose = ctx.synthetic(5, 400, true);
+    loose->set_uniform_capacity(total);
+    const auto relaxed = loose->optimize();
+    if (relaxed.first != expected.first || std::abs(relaxed.second - expected.second) > 1e-6 * expected.second)
+        return "a capacity above the total quantity changed the solution";
+
+    std::pair<std::vector<int>, double> binding[2];
+    for (int t = 0; t < 2; t++)
+    {
+        auto tight = ctx.synthetic(5, 400, true);
+        tight->set_uniform_capacity(total / 5 * 1.1);
+        tight->set_num_threads(t == 0 ? 1 : 4);
+        binding[t] = tight->optimize();
+    }
+    if (binding[0] != binding[1])
+        return "the capacitated solution differs between 1 and 4 threads";
+    if (!(binding[0].second > plain->calculate_total_cost(binding[0].first)))
+        return "a binding capacity did not raise the cost of its medoids";
+
+    // Reported loads and shares come from the flow, and a capacity too small
+    // for the total leaves the rest unserved, outside the transport cost
+    const double capacity = total / 5 * 0.8;
+    auto short_of = ctx.synthetic(5, 400, true);
+    short_of->set_uniform_capacity(capacity);
+    const auto overflowed = short_of->optimize();
+    std::ostringstream json_out, binary_out;
+    short_of->print_results(overflowed.first, overflowed.second, KMedoidsOptimizer::OutputFormat::Json, json_out);
+    short_of->print_results(overflowed.first, overflowed.second, KMedoidsOptimizer::OutputFormat::Binary, binary_out);
+    const JsonValue json = JsonParser(json_out.str()).parse();
+    const JsonValue *cost = json.find("total_cost"), *unserved = json.find("unserved");
+    const JsonValue *centers = json.find("centers"), *shares = json.find("shares");
+    if (!cost || !unserved || !centers || !shares || centers->array.size() != 5)
+        return "the capacitated JSON result is missing members";
+    if (std::abs(unserved->number - 0.2 * total) > 1e-6 * total)
+        return "the unserved quantity is " + std::to_string(unserved->number) + " instead of " + std::to_string(0.2 * total);
+    if (!(cost->number < overflowed.second) || std::abs(cost->number - short_of->transport_cost(overflowed.first)) > 1e-6 * cost->number)
+        return "the reported cost includes the overflow penalty";
+    std::map<double, double> by_center;
+    std::map<double, int> points_of;
+    for (const JsonValue &share : shares->array)
+    {
+        by_center[share.find("center")->number] += share.find("quantity")->number;
+        points_of[share.find("center")->number]++;
+    }
+    for (const JsonValue &center : centers->array)
+    {
+        const double id = center.find("id")->number, load = center.find("load")->number;
+        if (load > capacity * (1 + 1e-9) || std::abs(load - by_center[id]) > 1e-6 * capacity ||
+            center.find("num_points")->number != points_of[id])
+            return "a reported center load is not the flow's";
+    }
+
+    const std::string binary = binary_out.str();
+    BinaryResultHeader header;
+    std::memcpy(&header, binary.data(), sizeof(header));
+    const size_t points = short_of->get_points().size();
+    if (header.version != 2 || std::abs(header.total_cost - cost->number) > 1e-9 * cost->number ||
+        binary.size() != sizeof(header) + 5 * (sizeof(int32_t) + sizeof(double)) + points * 2 * sizeof(int32_t) + 2 * 8 +
+                             shares->array.size() * sizeof(BinaryResultShare))
+        return "the capacitated binary result does not carry the shares";
+    return "";
+}
+
+std::string check_geo_pruning(CheckContext &ctx)
+{
+    // The spatial grid prunes geo-only swaps, recomputations and
+    // min-distance conflicts; a dense matrix of the same Haversine
+    // distances scores every point and must reach the same solution
+    auto solve = [&](int k, double min_km, unsigned seed, const std::vector<double> *matrix)
+    {
+        auto optimizer = ctx.synthetic(k, 400, false);
+        optimizer->set_points(std::vector<Point>(optimizer->get_points())); // Drops the road distances
+        optimizer->set_constraints(k, min_km, {"wetland"}, 90.0);
+        optimizer->set_seed(seed);
+        if (matrix && !optimizer->set_distance_matrix(matrix->data(), 400, DistanceMatrix::F64))
+            throw std::runtime_error("cannot set the Haversine matrix");
+        return optimizer->optimize();
+    };
+    auto geo = ctx.synthetic(1, 400, false);
+    geo->set_points(std::vector<Point>(geo->get_points()));
+    if (!geo->geo_only())
+        return "points without road distances are not in geo-only mode";
+    std::vector<double> matrix(400 * 400);
+    for (size_t i = 0; i < 400; i++)
+        for (size_t j = 0; j < 400; j++)
+            matrix[i * 400 + j] = geo->haversine_idx(i, j);
+
+    for (const double min_km : {0.0, 8.0})
+    {
+        for (const int k : {2, 5, 9, 14})
+        {
+            for (unsigned seed = 1; seed <= 4; seed++)
+            {
+                const auto pruned = solve(k, min_km, seed, nullptr), full = solve(k, min_km, seed, &matrix);
+                if (pruned.first != full.first || std::abs(pruned.second - full.second) > 1e-9 * full.second)
+                    return "geo-only pruning changed the k=" + std::to_string(k) + " solution at " +
+                           std::to_string(min_km) + " km with seed " + std::to_string(seed);
+            }
+        }
+    }
+    return "";
+}
+
+std::string check_simd(CheckContext &ctx)
+{
+    // Every kernel set the CPU supports must match the scalar kernels:
+    // minima and slots exactly, on lengths that exercise the remainder
+    // loops and on ties, and whole solves on the same medoids
+    struct Restore
+    {
+        const CostKernels *saved = active_kernels();
+        ~Restore() { active_kernels() = saved; }
+    } restore;
+
+    std::mt19937 gen(5);
+    auto solve = [&]()
+    {
+        auto optimizer = ctx.synthetic(6, 400, true);
+        const auto result = optimizer->optimize();
+        return std::make_tuple(result.first, result.second, optimizer->get_assignments(result.first));
+    };
+    select_kernels("scalar");
+    const auto expected = solve();
+    for (const char *level : {"avx2", "avx512"})
+    {
+        if (!select_kernels(level))
+            continue; // Not supported by this CPU
+        const CostKernels &simd = *active_kernels();
+        for (size_t n = 0; n <= 37; n++)
+        {
+            std::vector<double> row(n), weights(n), start(n);
+            std::vector<float> row_f32(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                start[i] = gen() % 50;
+                row[i] = (i % 3 == 0) ? start[i] : gen() % 50; // Ties never move the slot
+                row_f32[i] = static_cast<float>(row[i]) + 0.25f;
+                weights[i] = gen() % 1000 / 7.0;
+            }
+            std::vector<double> best_a = start, best_b = start;
+            std::vector<int> slot_a(n, 0), slot_b(n, 0);
+            scalar_kernels.argmin_f64(best_a.data(), slot_a.data(), row.data(), 1, n);
+            simd.argmin_f64(best_b.data(), slot_b.data(), row.data(), 1, n);
+            scalar_kernels.argmin_f32(best_a.data(), slot_a.data(), row_f32.data(), 2, n);
+            simd.argmin_f32(best_b.data(), slot_b.data(), row_f32.data(), 2, n);
+            scalar_kernels.min_f64(best_a.data(), row.data(), n);
+            simd.min_f64(best_b.data(), row.data(), n);
+            scalar_kernels.min_f32(best_a.data(), row_f32.data(), n);
+            simd.min_f32(best_b.data(), row_f32.data(), n);
+            if (best_a != best_b || slot_a != slot_b)
+                return std::string(level) + " minima differ from scalar at length " + std::to_string(n);
+            const double a = scalar_kernels.weighted_sum(best_a.data(), weights.data(), n);
+            const double b = simd.weighted_sum(best_b.data(), weights.data(), n);
+            if (std::abs(a - b) > 1e-12 * std::max(1.0, std::abs(a)))
+                return std::string(level) + " weighted sum differs from scalar at length " + std::to_string(n);
+        }
+        const auto result = solve();
+        if (std::get<0>(result) != std::get<0>(expected) || std::get<2>(result) != std::get<2>(expected) ||
+            std::abs(std::get<1>(result) - std::get<1>(expected)) > 1e-9 * std::get<1>(expected))
+            return std::string(level) + " kernels changed the solution";
+    }
+    return "";
+}
+
+std::string check_precision(CheckContext &ctx)
+{
+    // f32 and u16 matrices, dense and through the binary format, must stay
+    // within their rounding of the f64 distances, and so must the cost of
+    // a solution; a unit too fine for u16 must be refused
+    const std::string path = ctx.synthetic_dataset(400, true);
+    auto load = [&](DistanceMatrix::DType type, double unit, const std::string &roads)
+    {
+        auto optimizer = std::make_unique<KMedoidsOptimizer>(6, 0.0, std::set<std::string>{"wetland"}, 90.0);
+        optimizer->set_verbose(false);
+        optimizer->set_seed(42);
+        optimizer->set_distance_precision(type, unit);
+        optimizer->load_points(path + "/resource_points.csv");
+        optimizer->load_zone_features(path + "/zone_features.csv");
+        optimizer->load_distances(roads);
+        return optimizer;
+    };
+    auto exact = load(DistanceMatrix::F64, 1.0, path + "/road_network.csv");
+    const auto solution = exact->optimize();
+    const size_t n = exact->get_points().size();
+    double total = 0.0;
+    for (const Point &p : exact->get_points())
+        total += p.resource_quantity;
+
+    const std::pair<DistanceMatrix::DType, double> precisions[] = {{DistanceMatrix::F32, 1.0}, {DistanceMatrix::U16, 10.0}};
+    for (const auto &[type, unit] : precisions)
+    {
+        const std::string name = type == DistanceMatrix::F32 ? "f32" : "u16";
+        auto dense = load(type, unit, path + "/road_network.csv");
+        const std::string bin = ctx.file("precision_" + name + ".bin");
+        if (!dense->save_distances_binary(bin))
+            return "cannot write " + bin;
+        auto mapped = load(type, unit, bin);
+        for (KMedoidsOptimizer *optimizer : {dense.get(), mapped.get()})
+        {
+            double worst = 0.0; // Largest error allowed anywhere
+            for (size_t i = 0; i < n; i++)
+            {
+                for (size_t j = 0; j < n; j++)
+                {
+                    const double a = exact->get_distance_idx(i, j), b = optimizer->get_distance_idx(i, j);
+                    const double allowed = type == DistanceMatrix::F32 ? 1e-7 * a : unit / 2 + 1e-9 * a;
+                    if (std::abs(a - b) > allowed)
+                        return name + " distance (" + std::to_string(i) + ", " + std::to_string(j) + ") is off by " +
+                               std::to_string(std::abs(a - b)) + " m";
+                    worst = std::max(worst, allowed);
+                }
+            }
+            const double cost = optimizer->calculate_total_cost(solution.first);
+            if (std::abs(cost - solution.second) > worst * total)
+                return name + " cost of the f64 solution is off by " + std::to_string(std::abs(cost - solution.second));
+        }
+    }
+
+    QuietErrors quiet;
+    try
+    {
+        load(DistanceMatrix::U16, 0.001, path + "/road_network.csv");
+    }
+    catch (const std::runtime_error &)
+    {
+        return "";
+    }
+    return "a u16 unit of 1 mm was accepted for distances beyond 65 m";
+}
+
+std::string check_tiled(CheckContext &ctx)
+{
+    // Rows staged through a small tile cache, with and without prefetches
+    // and under eviction, must equal the mapped rows, and a tiled solve must
+    // equal a solve that reads the mapped matrix directly
+    auto text = ctx.synthetic(6, 400, true);
+    const std::string bin = ctx.file("tiled.bin");
+    if (!text->save_distances_binary(bin))
+        return "cannot write " + bin;
+    auto matrix = std::make_shared<DistanceMatrix>();
+    std::vector<int> ids;
+    if (!matrix->map_binary(bin, ids))
+        return "cannot map " + bin;
+
+    const size_t bytes = matrix->row_bytes();
+    std::vector<int> rows;
+    for (int r = 1; r < 400; r += 2)
+        rows.push_back(r);
+    std::vector<std::vector<char>> expected;
+    for (int r : rows)
+        expected.emplace_back(matrix->raw_row(r), matrix->raw_row(r) + bytes);
+    TileCache cache(matrix, rows, 8, 3 * 8 * bytes); // Three tiles of eight rows fit
+    if (cache.rows_per_tile() != 8)
+        return "the tile cache holds " + std::to_string(cache.rows_per_tile()) + " rows per tile, not 8";
+    std::vector<int> order(rows.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(3);
+    for (int pass = 0; pass < 4; pass++)
+    {
+        if (pass == 3)
+            std::shuffle(order.begin(), order.end(), gen); // Single rows, no prefetch
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            if (pass < 3 && i % 8 == 0)
+                cache.prefetch(order.data() + i, std::min<size_t>(16, order.size() - i));
+            std::shared_ptr<const void> pin;
+            const char *row = cache.row(order[i], pin);
+            if (!std::equal(row, row + bytes, expected[order[i]].begin()))
+                return "staged row of position " + std::to_string(order[i]) + " differs in pass " + std::to_string(pass);
+        }
+    }
+
+    auto solve = [&](size_t cache_mb, int threads)
+    {
+        auto optimizer = ctx.synthetic(6, 400, false);
+        optimizer->load_distances(bin);
+        if (cache_mb)
+        {
+            optimizer->set_storage_mode(KMedoidsOptimizer::StorageMode::Tiled);
+            optimizer->set_tile_cache(cache_mb - 1); // 0 MB leaves one-row tiles
+        }
+        optimizer->set_num_threads(threads);
+        return optimizer->optimize();
+    };
+    const auto direct = solve(0, 1);
+    for (const size_t cache_mb : {1, 2})
+    {
+        for (const int threads : {1, 4})
+        {
+            if (solve(cache_mb, threads) != direct)
+                return "the tiled solution with a " + std::to_string(cache_mb - 1) + " MB cache on " +
+                       std::to_string(threads) + " threads differs from direct reads";
+        }
+    }
+    return "";
+}
+
+std::string check_budget(CheckContext &ctx)
+{
+    // Progress reports must improve strictly and end at the result, an
+    // evaluation budget must give the same result on any thread count and
+    // never a worse one when larger, and a spent deadline must still
+    // return a complete feasible solution
+    auto solve = [&](double seconds, uint64_t evaluations, int threads, std::vector<std::pair<std::vector<int>, double>> *reports)
+    {
+        auto optimizer = ctx.synthetic(6, 400, true);
+        optimizer->set_constraints(6, 5.0, {"wetland"}, 90.0);
+        optimizer->set_restarts(2);
+        optimizer->set_num_threads(threads);
+        optimizer->set_search_budget(seconds, evaluations);
+        if (reports)
+            optimizer->set_progress_callback([reports](const std::vector<int> &medoids, double cost, double)
+                                             { reports->emplace_back(medoids, cost); });
+        const auto result = optimizer->optimize();
+        const std::vector<int> &candidates = optimizer->get_valid_candidates();
+        bool feasible = result.first.size() == 6;
+        for (size_t a = 0; a < result.first.size(); a++)
+        {
+            feasible = feasible && std::count(candidates.begin(), candidates.end(), result.first[a]);
+            for (size_t b = 0; b < a; b++)
+                feasible = feasible && optimizer->get_distance_idx(result.first[a], result.first[b]) >= 5000 &&
+                           optimizer->get_distance_idx(result.first[b], result.first[a]) >= 5000;
+        }
+        if (!feasible)
+            throw std::runtime_error("a budgeted solve returned an incomplete or infeasible solution");
+        if (reports)
+        {
+            for (size_t r = 0; r < reports->size(); r++)
+            {
+                const auto &[medoids, cost] = (*reports)[r];
+                if ((r > 0 && !(cost < (*reports)[r - 1].second)) ||
+                    std::abs(optimizer->calculate_total_cost(medoids) - cost) > 1e-9 * cost)
+                    throw std::runtime_error("progress report " + std::to_string(r) + " does not improve on the last or misstates its cost");
+            }
+        }
+        return result;
+    };
+
+    const auto plain = solve(0.0, 0, 1, nullptr);
+    std::vector<std::pair<std::vector<int>, double>> reports;
+    if (solve(0.0, 0, 4, &reports) != plain)
+        return "a progress callback changed the solution";
+    if (reports.empty() || reports.back() != plain)
+        return "the last progress report is not the result";
+
+    double previous = std::numeric_limits<double>::max();
+    for (const uint64_t evaluations : {1, 40, 300, 2000, 20000})
+    {
+        const auto one = solve(0.0, evaluations, 1, nullptr);
+        if (solve(0.0, evaluations, 4, nullptr) != one)
+            return "a budget of " + std::to_string(evaluations) + " evaluations differs between 1 and 4 threads";
+        if (one.second > previous || one.second < plain.second)
+            return "a budget of " + std::to_string(evaluations) + " evaluations is out of order with smaller budgets";
+        previous = one.second;
+    }
+    if (previous != plain.second)
+        return "an evaluation budget larger than the search did not reach the unbudgeted result";
+
+    const auto rushed = solve(1e-9, 0, 4, nullptr); // Spent before the search starts
+    if (rushed.second < plain.second)
+        return "a spent deadline beat the full search";
+    return "";
+}
+
+std::string check_bounded_cost(CheckContext &ctx)
+{
+    // An unbounded sum must equal the full cost, and a bounded one must
+    // stop only for medoid sets whose full cost reaches the bound, on
+    // f64, f32 and geo-only distances
+    std::mt19937 gen(9);
+    for (int mode = 0; mode < 3; mode++)
+    {
+        auto optimizer = ctx.synthetic(5, 400, true);
+        std::vector<float> f32;
+        const size_t n = optimizer->get_points().size();
+        if (mode == 1)
+        {
+            f32.resize(n * n);
+            for (size_t to = 0; to < n; to++)
+                for (size_t from = 0; from < n; from++)
+                    f32[to * n + from] = optimizer->get_distance_idx(from, to);
+            optimizer->set_distance_matrix(f32.data(), n, DistanceMatrix::F32);
+        }
+        else if (mode == 2)
+            optimizer->set_points(std::vector<Point>(optimizer->get_points())); // Drops the road distances
+        optimizer->filter_candidates();
+        optimizer->build_cost_order();
+        const std::vector<int> &candidates = optimizer->get_valid_candidates();
+        const char *name = mode == 0 ? "f64" : mode == 1 ? "f32" : "geo-only";
+        KMedoidsOptimizer::CostScratch scratch;
+        for (int trial = 0; trial < 20; trial++)
+        {
+            std::vector<int> medoids;
+            for (int j = 0; j < 5; j++)
+                medoids.push_back(candidates[gen() % candidates.size()]);
+            const double exact = optimizer->calculate_total_cost(medoids);
+            const double full = optimizer->bounded_total_cost(medoids, std::numeric_limits<double>::max(), scratch);
+            if (std::abs(full - exact) > 1e-9 * exact)
+                return std::string(name) + " unbounded sum differs from the full cost";
+            const double bound = exact * (0.5 + (gen() % 100) / 99.0); // Below or above the full cost
+            const double bounded = optimizer->bounded_total_cost(medoids, bound, scratch);
+            if ((bounded < bound) != (exact < bound) || (bounded < bound && std::abs(bounded - exact) > 1e-9 * exact))
+                return std::string(name) + " bounded sum disagrees with the full cost at bound " + std::to_string(bound);
+        }
+    }
+    return "";
+}
+
+std::string check_haversine_fallback(CheckContext &ctx)
+{
+    // Blank road cells must read as the Haversine distance between the
+    // points and the others as the CSV value in meters; with no road data
+    // every pair is Haversine
+    std::ifstream in(ctx.data + "/road_network.csv");
+    std::vector<std::vector<std::string>> cells;
+    for (std::string line; std::getline(in, line);)
+    {
+        std::vector<std::string> row;
+        std::stringstream fields(line);
+        for (std::string field; std::getline(fields, field, ',');)
+            row.push_back(field);
+        cells.push_back(row);
+    }
+    const std::string holes = ctx.file("holes.csv");
+    {
+        std::ofstream out(holes);
+        for (size_t r = 0; r < cells.size(); r++)
+        {
+            for (size_t c = 0; c < cells[r].size(); c++)
+                out << (c ? "," : "") << (r > 0 && c > 0 && (2 * r + c) % 5 == 0 ? "" : cells[r][c]);
+            out << "\n";
+        }
+    }
+
+    auto roads = ctx.fixture(3, false);
+    roads->load_distances(holes);
+    auto geo = ctx.fixture(3, false);
+    const std::vector<Point> &points = roads->get_points();
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        for (size_t j = 0; j < points.size(); j++)
+        {
+            const double straight = KMedoidsOptimizer::haversine_distance(points[i].lat, points[i].lon, points[j].lat, points[j].lon);
+            const bool blank = (2 * (i + 1) + j + 1) % 5 == 0; // Not symmetric
+            const double expected = blank ? straight : std::stod(cells[i + 1][j + 1]) * 1000;
+            if (std::abs(roads->get_distance_idx(i, j) - expected) > (blank ? 1e-9 * straight + 1e-6 : 0.0))
+                return "distance (" + std::to_string(i) + ", " + std::to_string(j) + ") is not the " +
+                       (blank ? "Haversine fallback" : "CSV value");
+            if (std::abs(geo->get_distance_idx(i, j) - straight) > 1e-9 * straight + 1e-6)
+                return "geo-only distance (" + std::to_string(i) + ", " + std::to_string(j) + ") is not Haversine";
+        }
+    }
+    return "";
+}
+
+std::string check_binary_round_trip(CheckContext &ctx)
+{
+    auto text = ctx.fixture(3);
+    const size_t n = text->get_points().size();
+    for (DistanceMatrix::DType type : {DistanceMatrix::F64, DistanceMatrix::F32})
+    {
+        const std::string bin = ctx.file(type == DistanceMatrix::F64 ? "f64.bin" : "f32.bin");
+        text->set_distance_precision(type, 1.0);
+        if (!text->save_distances_binary(bin))
+            return "cannot write " + bin;
+
+        auto mapped = ctx.fixture(3, false);
+        mapped->load_distances(bin);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                const double a = text->get_distance_idx(i, j), b = mapped->get_distance_idx(i, j);
+                if (type == DistanceMatrix::F64 ? a != b : std::abs(a - b) > 1e-6 * std::max(1.0, a))
+                    return bin + " differs at (" + std::to_string(i) + ", " + std::to_string(j) + ")";
+            }
+        }
+        if (type == DistanceMatrix::F64 && text->optimize() != mapped->optimize())
+            return "solution from " + bin + " differs from the CSV solution";
+    }
+    return "";
+}
+
+std::string check_binary_corrupt(CheckContext &ctx)
+{
+    auto text = ctx.fixture(3);
+    const std::string good = ctx.file("good.bin");
+    if (!text->save_distances_binary(good))
+        return "cannot write " + good;
+    std::ifstream in(good, std::ios::binary);
+    const std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    BinaryMatrixHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    auto patched = [&](BinaryMatrixHeader h)
+    {
+        std::string copy = bytes;
+        std::memcpy(&copy[0], &h, sizeof(h));
+        return copy;
+    };
+    BinaryMatrixHeader huge = header, wrap = header, overlap = header, past = header, skew = header;
+    huge.n = uint64_t(1) << 62;
+    wrap.n = (uint64_t(1) << 32) + 1; // n * n * 8 wraps to a small value
+    overlap.data_offset = sizeof(header);
+    past.data_offset = ~uint64_t(0) - 7;
+    skew.data_offset += 1;
+    const std::pair<const char *, std::string> cases[] = {
+        {"truncated", bytes.substr(0, bytes.size() / 2)}, {"header-only", bytes.substr(0, sizeof(header))},
+        {"huge-n", patched(huge)}, {"wrapping-n", patched(wrap)}, {"overlapping-offset", patched(overlap)},
+        {"offset-past-end", patched(past)}, {"unaligned-offset", patched(skew)}};
+    for (const auto &c : cases)
+    {
+        const std::string name = ctx.file(std::string(c.first) + ".bin");
+        std::ofstream(name, std::ios::binary) << c.second;
+        DistanceMatrix matrix;
+        std::vector<int> ids;
+        QuietErrors quiet;
+        if (matrix.map_binary(name, ids))
+            return std::string("accepted the ") + c.first + " file";
+    }
+    return "";
+}
+
+std::string check_lab_unreachable(CheckContext &ctx)
+{
+    // Every sampled cost overflows to infinity, so LAB picks nothing and
+    // has to hand over to BUILD
+    auto optimizer = ctx.fixture(4, false);
+    const size_t n = optimizer->get_points().size();
+    std::vector<double> unreachable(n * n, 1e306);
+    optimizer->set_distance_matrix(unreachable.data(), n, DistanceMatrix::F64);
+    optimizer->set_init_method(KMedoidsOptimizer::InitMethod::Lab);
+    const std::vector<int> medoids = optimizer->optimize().first;
+    if (medoids.size() != 4)
+        return "chose " + std::to_string(medoids.size()) + " of 4 medoids";
+    return "";
+}
+
+std::string check_distributed(CheckContext &ctx)
+{
+    const std::string resources = ctx.data + "/resource_points.csv", zones = ctx.data + "/zone_features.csv";
+    const std::set<std::string> excluded{"wetland"};
+    const std::string binary = ctx.file("distributed.bin");
+    if (!ctx.fixture(3)->save_distances_binary(binary))
+        return "cannot write " + binary;
+
+    // Solves on workers that serve one session each on loopback ports
+    auto solve = [&](const std::string &roads, int num_workers, const std::string &token)
+    {
+        std::vector<int> listeners;
+        std::vector<std::string> endpoints;
+        std::vector<std::thread> workers;
+        for (int w = 0; w < num_workers; w++)
+        {
+            const int fd = open_tcp("127.0.0.1:0", true);
+            sockaddr_in address{};
+            socklen_t length = sizeof(address);
+            if (fd < 0 || ::getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+                throw std::runtime_error("cannot listen on loopback");
+            listeners.push_back(fd);
+            endpoints.push_back("127.0.0.1:" + std::to_string(ntohs(address.sin_port)));
+            workers.emplace_back([fd] { PartitionWorker(1, "check", false).serve(fd, 1); });
+        }
+
+        KMedoidsOptimizer optimizer(3, 2.0, excluded, 25.0);
+        optimizer.set_verbose(false);
+        optimizer.set_seed(42);
+        optimizer.load_points(resources);
+        optimizer.load_zone_features(zones);
+        optimizer.load_distances(roads);
+        std::map<std::string, std::string> options{{"token", token}};
+        std::pair<std::vector<int>, double> result;
+        {
+            PartitionCoordinator coordinator(endpoints, partition_setup(resources, zones, roads, 3, 2.0, 25.0, excluded, options),
+                                             optimizer);
+            if (coordinator.connect())
+            {
+                optimizer.set_pass_scorer(coordinator.scorer());
+                result = optimizer.optimize();
+            }
+        }
+        for (size_t w = 0; w < workers.size(); w++)
+        {
+            ::shutdown(listeners[w], SHUT_RDWR); // Wakes a worker nobody connected to
+            workers[w].join();
+            ::close(listeners[w]);
+        }
+        if (!result.first.empty() && std::abs(result.second - optimizer.calculate_total_cost(result.first)) > 1e-9 * result.second)
+            throw std::runtime_error("reported cost differs from the cost of the medoids");
+        return result;
+    };
+
+    const std::pair<std::vector<int>, double> one = solve(binary, 1, "check");
+    if (one.first.size() != 3)
+        return "one worker chose " + std::to_string(one.first.size()) + " of 3 medoids";
+    if (solve(binary, 2, "check") != one || solve(binary, 3, "check") != one)
+        return "the solution depends on the worker count";
+    QuietErrors quiet;
+    if (!solve(ctx.data + "/road_network.csv", 2, "check").first.empty())
+        return "workers accepted a dense CSV matrix";
+    if (!solve(binary, 2, "wrong").first.empty())
+        return "workers accepted a wrong token";
+    return "";
+}
+
+std::string check_server(CheckContext &ctx)
+{
+    const std::string socket_path = ctx.file("server.sock");
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    auto connect_client = [&]
+    {
+        for (int attempt = 0; attempt < 500; attempt++)
+        {
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0)
+                return fd;
+            if (fd >= 0)
+                ::close(fd);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return -1;
+    };
+    // A fresh connection stops a server even after a failed exchange
+    auto stop = [&](std::thread &serving)
+    {
+        const int fd = connect_client();
+        if (fd >= 0)
+        {
+            std::string line;
+            LineReader stopped(fd);
+            if (send_all(fd, "{\"op\": \"shutdown\"}\n"))
+                stopped.next(line);
+            ::close(fd);
+        }
+        serving.join();
+    };
+
+    {
+        std::ofstream(socket_path) << "not a socket\n";
+        QuietErrors quiet;
+        SolveServer refused({}, 1, 1, false);
+        std::atomic<bool> returned{false};
+        std::thread refusing([&] { refused.run(socket_path); returned = true; });
+        for (int wait = 0; wait < 200 && !returned; wait++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (!returned)
+        {
+            stop(refusing);
+            return "the server replaced a regular file at the socket path";
+        }
+        refusing.join();
+    }
+    ::unlink(socket_path.c_str());
+
+    SolveServer server({}, 1, 1, false);
+    std::thread serving([&] { server.run(socket_path); });
+    const int fd = connect_client();
+    if (fd < 0)
+    {
+        stop(serving);
+        return "cannot connect to the server";
+    }
+
+    LineReader reader(fd);
+    auto call = [&](const std::string &request)
+    {
+        std::string line;
+        if (!send_all(fd, request + "\n") || !reader.next(line))
+            throw std::runtime_error("the server closed the connection");
+        return JsonParser(line).parse();
+    };
+    auto ok = [](const JsonValue &response)
+    {
+        const JsonValue *v = response.find("ok");
+        return v && v->type == JsonValue::Type::Bool && v->boolean;
+    };
+    auto cost = [](const JsonValue &response)
+    {
+        const JsonValue *result = response.find("result");
+        const JsonValue *total = result ? result->find("total_cost") : nullptr;
+        return total ? total->number : -1.0;
+    };
+
+    std::string problem;
+    try
+    {
+        const std::string scenario = "\"op\": \"solve\", \"dataset\": \"fixture\", \"k\": 3, \"options\": {\"seed\": 42}";
+        const JsonValue loaded = call("{\"op\": \"load\", \"dataset\": \"fixture\", \"resource_file\": " +
+                                      json_quote(ctx.data + "/resource_points.csv") + ", \"zone_file\": " +
+                                      json_quote(ctx.data + "/zone_features.csv") + ", \"road_file\": " +
+                                      json_quote(ctx.data + "/road_network.csv") + "}");
+        const JsonValue cold = ok(loaded) ? call("{" + scenario + "}") : JsonValue();
+        std::pair<std::vector<int>, double> direct = ctx.fixture(3)->optimize();
+        if (!ok(loaded) || !ok(cold))
+            problem = "the fixture did not load or solve";
+        else if (std::abs(cost(cold) - direct.second) > 1e-9 * direct.second)
+            problem = "the server's cost differs from a direct solve";
+        else
+        {
+            std::string ids;
+            for (const JsonValue &center : cold.find("result")->find("centers")->array)
+                ids += (ids.empty() ? "" : ", ") + std::to_string(static_cast<int>(center.find("id")->number));
+            const JsonValue warm = call("{" + scenario + ", \"initial_medoids\": [" + ids + "]}");
+            if (!ok(warm) || std::abs(cost(warm) - cost(cold)) > 1e-9 * cost(cold))
+                problem = "a warm start from the solution did not return it";
+            else if (ok(call("{\"op\": \"solve\", \"dataset\": \"fixture\", \"k\": 3, \"options\": {\"initial-medoids\": " +
+                             json_quote(ctx.data + "/resource_points.csv") + "}}")))
+                problem = "the server accepted a file path for initial-medoids";
+        }
+
+        struct stat socket_stat;
+        QuietErrors quiet;
+        if (problem.empty() && (::stat(socket_path.c_str(), &socket_stat) != 0 || (socket_stat.st_mode & 0777) != 0600))
+            problem = "the socket is not private to its owner";
+        else if (problem.empty() &&
+                 ok(call("{\"op\": \"load\", \"dataset\": \"partial\", \"resource_file\": " +
+                         json_quote(ctx.data + "/resource_points.csv") + ", \"zone_file\": " +
+                         json_quote(ctx.data + "/missing.csv") + ", \"road_file\": \"none\"}")))
+            problem = "the server loaded a dataset without its zone file";
+    }
+    catch (const std::exception &e)
+    {
+        problem = e.what();
+    }
+    ::close(fd);
+    stop(serving);
+    if (!problem.empty())
+        return problem;
+
+    // A dataset's algorithm carries over to its solves' options
+    auto optimizer = ctx.fixture(3, false);
+    std::map<std::string, std::string> dataset{{"algorithm", "clara"}}, request{{"capacity", "100"}};
+    QuietErrors quiet;
+    if (!configure_optimizer(*optimizer, dataset) || configure_optimizer(*optimizer, request))
+        return "--capacity was accepted on top of an earlier --algorithm clara";
+    return "";
+}
+
+std::vector<SelfCheck> self_checks()
+{
+    return {
+        {"csv-malformed", check_csv_malformed},
+        {"swap-optimum", check_swap_optimum},
+        {"threads", check_threads},
+        {"road-graph", check_road_graph},
+        {"candidate-storage", check_candidate_storage},
+        {"min-distance", check_min_distance},
+        {"binary-round-trip", check_binary_round_trip},
+        {"binary-corrupt", check_binary_corrupt},
+        {"lab-unreachable", check_lab_unreachable},
+        {"sampling", check_sampling},
+        {"restarts", check_restarts},
+        {"batch", check_batch},
+        {"warm-start", check_warm_start},
+        {"live-updates", check_live_updates},
+        {"output-formats", check_output_formats},
+        {"synthetic-data", check_synthetic_data},
+        {"stats", check_stats},
+        {"terrain-filter", check_terrain_filter},
+        {"capacity", check_capacity},
+        {"geo-pruning", check_geo_pruning},
+        {"simd", check_simd},
+        {"precision", check_precision},
+        {"tiled", check_tiled},
+        {"budget", check_budget},
+        {"bounded-cost", check_bounded_cost},
+        {"haversine-fallback", check_haversine_fallback},
+        {"distributed", check_distributed},
+        {"server", check_server},
+    };
+}
+
+// Runs the deterministic self-checks on the fixtures in --data; non-zero
+// when any of them fails
+int run_checks(std::map<std::string, std::string> &options)
+{
+    CheckContext ctx;
+    ctx.data = options.count("data") ? options["data"] : "data";
+    std::set<std::string> only;
+    if (options.count("only"))
+        only = parse_land_types(options["only"], ",");
+
+    char dir_template[] = "/tmp/center_check_XXXXXX";
+    if (!mkdtemp(dir_template))
+    {
+        std::cerr << "Error: Cannot create a temporary directory" << std::endl;
+        return 1;
+    }
+    ctx.dir = dir_template;
+
+    int run = 0, failed = 0;
+    for (const SelfCheck &check : self_checks())
+    {
+        if (!only.empty() && !only.count(check.name))
+            continue;
+        std::string problem;
+        try
+        {
+            problem = check.run(ctx);
+        }
+        catch (const std::exception &e)
+        {
+            problem = std::string("threw ") + e.what();
+        }
+        run++;
+        if (!problem.empty())
+            failed++;
+        std::cout << (problem.empty() ? "ok   " : "FAIL ") << check.name << (problem.empty() ? "" : ": " + problem) << std::endl;
+    }
+
+    for (const std::string &file : ctx.files)
+        unlink(file.c_str());
+    for (const std::string &dir : ctx.dirs)
+        rmdir(dir.c_str());
+    rmdir(ctx.dir.c_str());
+
+    if (run == 0)
+    {
+        std::cerr << "Error: No checks match --only " << options["only"] << std::endl;
+        return 1;
+    }
+    std::cout << run - failed << "/" << run << " checks passed" << std::endl;
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::map<std::string, std::string> options;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0 || i + 1 >= argc)
+        {
+            std::cerr << "Usage: " << argv[0] << " [--data data] [--only name,...]" << std::endl;
+            return 1;
+        }
+        options[arg.substr(2)] = argv[i + 1];
+    }
+    return run_checks(options);
+}
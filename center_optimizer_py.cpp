@@ -0,0 +1,283 @@
+// Python bindings for KMedoidsOptimizer (pybind11). Build with:
+//   c++ -std=c++17 -O3 -shared -fPIC -pthread $(python3 -m pybind11 --includes) \
+//       center_optimizer_py.cpp -o center_optimizer_py$(python3-config --extension-suffix)
+//
+// Points come in as numpy arrays and are copied once into the optimizer's
+// own records; distances come in as an (n, n) float64 or float32 array in
+// meters, which is borrowed and read in place when it is C-contiguous. Row r
+// holds the distances from every point to point r (any symmetric matrix
+// works as is) and NaN marks missing pairs, which fall back to Haversine.
+// optimize() runs without the GIL and results come back as numpy arrays.
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#define CENTER_OPTIMIZER_NO_MAIN
+#include "center_optimizer.cpp"
+
+namespace py = pybind11;
+
+using DoubleArray = py::array_t<double, py::array::c_style | py::array::forcecast>;
+using IdArray = py::array_t<int64_t, py::array::c_style | py::array::forcecast>;
+
+// The optimizer plus the numpy matrix it borrows
+class PyOptimizer
+{
+private:
+    KMedoidsOptimizer optimizer;
+    py::object distances; // Keeps the borrowed matrix alive
+    py::object progress;  // Progress callback, or None
+    std::exception_ptr progress_error; // Raised by the callback; rethrown after optimize()
+    std::vector<int> medoids;
+    double total_cost = 0.0;
+    mutable int running = 0; // Calls working on the data without the GIL
+
+    // Counts a call as running for as long as it holds the data
+    struct Running
+    {
+        int &count;
+        explicit Running(int &calls) : count(calls) { count++; }
+        ~Running() { count--; }
+    };
+
+    void require_solution() const
+    {
+        if (medoids.empty())
+            throw std::runtime_error("No solution; call optimize() first");
+    }
+
+    // Another thread must not replace the data, and free a borrowed
+    // matrix, while a call is reading it
+    void require_idle() const
+    {
+        if (running)
+            throw std::runtime_error("The optimizer is in use by another thread");
+    }
+
+public:
+    PyOptimizer(int k, double min_distance_km, const std::vector<std::string> &exclude_land_types, double max_slope)
+        : optimizer(k, min_distance_km, std::set<std::string>(exclude_land_types.begin(), exclude_land_types.end()), max_slope)
+    {
+    }
+
+    // Same names and values as the command-line options, e.g.
+    // configure(threads=4, init="build", seed=42)
+    void configure(py::kwargs kwargs)
+    {
+        require_idle();
+        std::map<std::string, std::string> options;
+        for (auto item : kwargs)
+        {
+            std::string name = py::str(item.first);
+            std::replace(name.begin(), name.end(), '_', '-');
+            options[name] = py::str(item.second);
+        }
+        if (!configure_optimizer(optimizer, options))
+            throw py::value_error("Invalid optimizer option");
+        if (options.count("initial-medoids"))
+            optimizer.set_initial_medoids(load_initial_medoids(options["initial-medoids"]));
+    }
+
+    void set_verbose(bool verbose)
+    {
+        require_idle();
+        optimizer.set_verbose(verbose);
+    }
+
+    // callback(center_ids, total_cost, seconds) runs for every improving
+    // solution during optimize(); None removes it
+    void set_progress(py::object callback)
+    {
+        require_idle();
+        progress = callback;
+        if (callback.is_none())
+        {
+            optimizer.set_progress_callback(nullptr);
+            return;
+        }
+        optimizer.set_progress_callback([this](const std::vector<int> &centers, double cost, double seconds)
+        {
+            py::gil_scoped_acquire acquire;
+            if (progress_error)
+                return;
+            const std::vector<Point> &points = optimizer.get_points();
+            py::array_t<int32_t> ids(centers.size());
+            int32_t *out = ids.mutable_data();
+            for (size_t j = 0; j < centers.size(); j++)
+                out[j] = points[centers[j]].id;
+            try
+            {
+                progress(ids, cost, seconds);
+            }
+            catch (py::error_already_set &)
+            {
+                progress_error = std::current_exception();
+            }
+        });
+    }
+
+    // Copies the arrays; only the distance matrix is borrowed, since the
+    // point data is O(N) and the optimizer keeps it as records and columns
+    void set_points(IdArray ids, DoubleArray lat, DoubleArray lon, DoubleArray quantity,
+                    py::object land_type, py::object slope, py::object elevation)
+    {
+        require_idle();
+        const size_t n = ids.size();
+        if (lat.size() != n || lon.size() != n || quantity.size() != n)
+            throw py::value_error("ids, lat, lon and quantity must have the same length");
+
+        std::vector<std::string> types;
+        if (!land_type.is_none())
+            types = land_type.cast<std::vector<std::string>>();
+        DoubleArray slopes = slope.is_none() ? DoubleArray(n) : slope.cast<DoubleArray>();
+        DoubleArray elevations = elevation.is_none() ? DoubleArray(n) : elevation.cast<DoubleArray>();
+        if ((!types.empty() && types.size() != n) || slopes.size() != n || elevations.size() != n)
+            throw py::value_error("land_type, slope and elevation must match the number of points");
+
+        const int64_t *id = ids.data();
+        const double *la = lat.data(), *lo = lon.data(), *q = quantity.data();
+        const double *sl = slope.is_none() ? nullptr : slopes.data();
+        const double *el = elevation.is_none() ? nullptr : elevations.data();
+
+        std::vector<Point> points(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            points[i].id = static_cast<int>(id[i]);
+            points[i].lat = la[i];
+            points[i].lon = lo[i];
+            points[i].resource_quantity = q[i];
+            points[i].land_type = types.empty() ? std::string() : types[i];
+            points[i].slope = sl ? sl[i] : 0.0;
+            points[i].elevation = el ? el[i] : 0.0;
+        }
+        optimizer.set_points(points);
+        distances = py::none(); // The optimizer no longer points into it
+        medoids.clear();
+    }
+
+    void set_distances(py::array matrix)
+    {
+        require_idle();
+        // Anything other than a C-contiguous float64/float32 array is
+        // converted once; the converted copy is kept alive instead
+        auto dtype = DistanceMatrix::F64;
+        if (py::isinstance<py::array_t<float>>(matrix) && (matrix.flags() & py::array::c_style))
+            dtype = DistanceMatrix::F32;
+        else
+            matrix = DoubleArray::ensure(matrix);
+        if (!matrix || matrix.ndim() != 2 || matrix.shape(0) != matrix.shape(1))
+            throw py::value_error("distances must be an (n, n) array");
+        if (!optimizer.set_distance_matrix(matrix.data(), matrix.shape(0), dtype))
+            throw py::value_error("distances do not match the loaded points");
+        distances = matrix; // Releases the previous matrix only now that it is replaced
+        medoids.clear();
+    }
+
+    // File loaders, as used by the command-line tool; they replace the
+    // points and any borrowed matrix
+    void load_files(const std::string &resource_file, const std::string &zone_file, const std::string &road_file)
+    {
+        require_idle();
+        optimizer.set_points({});
+        distances = py::none();
+        medoids.clear();
+        Running busy(running);
+        py::gil_scoped_release release;
+        optimizer.load_points(resource_file);
+        optimizer.load_zone_features(zone_file);
+        optimizer.load_distances(road_file);
+    }
+
+    // Returns (center_ids, total_cost)
+    py::tuple optimize()
+    {
+        std::pair<std::vector<int>, double> result;
+        require_idle();
+        progress_error = nullptr;
+        {
+            Running busy(running);
+            py::gil_scoped_release release;
+            result = optimizer.optimize();
+        }
+        if (progress_error)
+            std::rethrow_exception(std::exchange(progress_error, nullptr));
+        medoids = result.first;
+        total_cost = result.second;
+        return py::make_tuple(center_ids(), total_cost);
+    }
+
+    py::array_t<int32_t> center_ids() const
+    {
+        require_solution();
+        const std::vector<Point> &points = optimizer.get_points();
+        py::array_t<int32_t> out(medoids.size());
+        int32_t *ids = out.mutable_data();
+        for (size_t j = 0; j < medoids.size(); j++)
+            ids[j] = points[medoids[j]].id;
+        return out;
+    }
+
+    // Center ID of each point, in point order
+    py::array_t<int32_t> assignments() const
+    {
+        require_solution();
+        const std::vector<Point> &points = optimizer.get_points();
+        std::vector<int> slots;
+        {
+            Running busy(running);
+            py::gil_scoped_release release;
+            slots = optimizer.get_assignments(medoids);
+        }
+        py::array_t<int32_t> out(slots.size());
+        int32_t *centers = out.mutable_data();
+        for (size_t i = 0; i < slots.size(); i++)
+            centers[i] = points[medoids[slots[i]]].id;
+        return out;
+    }
+
+    py::array_t<int32_t> point_ids() const
+    {
+        const std::vector<Point> &points = optimizer.get_points();
+        py::array_t<int32_t> out(points.size());
+        int32_t *ids = out.mutable_data();
+        for (size_t i = 0; i < points.size(); i++)
+            ids[i] = points[i].id;
+        return out;
+    }
+
+    double cost() const
+    {
+        require_solution();
+        return total_cost;
+    }
+};
+
+PYBIND11_MODULE(center_optimizer_py, m)
+{
+    m.doc() = "K-medoids placement of resource collection centers";
+
+    py::class_<PyOptimizer>(m, "KMedoidsOptimizer")
+        .def(py::init<int, double, const std::vector<std::string> &, double>(),
+             py::arg("k"), py::arg("min_distance_km") = 2.0,
+             py::arg("exclude_land_types") = std::vector<std::string>(), py::arg("max_slope") = 30.0)
+        .def("configure", &PyOptimizer::configure,
+             "Command-line options by name: threads, storage, init, algorithm, samples, sample_size, "
+             "max_neighbors, seed, restarts, initial_medoids, capacity, simd, distance_precision, tile_cache, "
+             "time_budget, max_evals")
+        .def("set_verbose", &PyOptimizer::set_verbose, py::arg("verbose"))
+        .def("set_progress", &PyOptimizer::set_progress, py::arg("callback"),
+             "callback(center_ids, total_cost, seconds) for each improving solution; None removes it")
+        .def("set_points", &PyOptimizer::set_points,
+             py::arg("ids"), py::arg("lat"), py::arg("lon"), py::arg("quantity"),
+             py::arg("land_type") = py::none(), py::arg("slope") = py::none(), py::arg("elevation") = py::none(),
+             "Copies the point arrays; later changes to them have no effect")
+        .def("set_distances", &PyOptimizer::set_distances, py::arg("distances"),
+             "(n, n) road distances in meters; row r holds the distances to point r")
+        .def("load_files", &PyOptimizer::load_files,
+             py::arg("resource_file"), py::arg("zone_file"), py::arg("road_file"))
+        .def("optimize", &PyOptimizer::optimize, "Returns (center_ids, total_cost)")
+        .def("center_ids", &PyOptimizer::center_ids)
+        .def("assignments", &PyOptimizer::assignments, "Center ID of each point, in point order")
+        .def("point_ids", &PyOptimizer::point_ids)
+        .def_property_readonly("total_cost", &PyOptimizer::cost);
+}
@@ -21,13 +21,21 @@ fi
 
 # Compile the C++ optimizer
 echo "🔨 Compiling C++ optimizer..."
-if $COMPILER -std=c++17 -O3 -o center_optimizer center_optimizer.cpp; then
+if $COMPILER -std=c++17 -O3 -pthread -o center_optimizer center_optimizer.cpp; then
     echo "✅ C++ optimizer compiled successfully"
 else
     echo "❌ Failed to compile C++ optimizer"
     exit 1
 fi
 
+# Build and run the self-checks
+echo "🧪 Running self-checks..."
+if $COMPILER -std=c++17 -O3 -pthread -o center_optimizer_check center_optimizer_check.cpp && ./center_optimizer_check; then
+    echo "✅ Self-checks passed"
+else
+    echo "⚠️  Self-checks failed; see the output above"
+fi
+
 # Check Python version
 echo "🐍 Checking Python version..."
 if command -v python3 &> /dev/null; then
@@ -57,6 +65,16 @@ else
     echo "   Try: pip install --user -r requirements.txt"
 fi
 
+# Build the optional Python extension
+echo "🔨 Building Python extension..."
+if $PYTHON_CMD -m pybind11 --includes &> /dev/null && \
+   $COMPILER -std=c++17 -O3 -shared -fPIC -pthread $($PYTHON_CMD -m pybind11 --includes) \
+       center_optimizer_py.cpp -o center_optimizer_py$($PYTHON_CMD-config --extension-suffix); then
+    echo "✅ Python extension built"
+else
+    echo "⚠️  Python extension not built (needs pybind11); scripts fall back to the executable"
+fi
+
 # Check if data files exist and are in correct location
 echo "📁 Checking data files..."
 if [ -f "data/resource_points.csv" ] || [ -f "resource_points (1).csv" ]; then
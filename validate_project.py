@@ -39,7 +39,7 @@ def test_cpp_compilation() -> bool:
             return True
         
         # Try to compile
-        result = subprocess.run(['g++', '-std=c++17', '-O3', '-o', 'center_optimizer', 'center_optimizer.cpp'], 
+        result = subprocess.run(['g++', '-std=c++17', '-O3', '-pthread', '-o', 'center_optimizer', 'center_optimizer.cpp'], 
                               capture_output=True, text=True)
         if result.returncode == 0:
             print("✅ C++ optimizer compiled successfully")
@@ -120,6 +120,25 @@ def test_optimizer_execution(datasets: Dict) -> bool:
         print(f"❌ Optimizer execution error: {e}")
         return False
 
+def test_self_checks() -> bool:
+    """Run the optimizer's deterministic self-checks on the data fixtures"""
+    try:
+        result = subprocess.run(['./center_optimizer', 'check', '--data', 'data'], capture_output=True, text=True, timeout=120)
+        for line in result.stdout.strip().split('\n'):
+            if line.startswith('FAIL'):
+                print(f"❌ {line}")
+        if result.returncode == 0:
+            print(f"✅ Self-checks passed: {result.stdout.strip().splitlines()[-1]}")
+            return True
+        print(f"❌ Self-checks failed: {result.stderr.strip() or result.stdout.strip().splitlines()[-1]}")
+        return False
+    except subprocess.TimeoutExpired:
+        print("❌ Self-checks timed out")
+        return False
+    except Exception as e:
+        print(f"❌ Self-check error: {e}")
+        return False
+
 def test_python_scripts() -> bool:
     """Test Python scripts can import and run basic functions"""
     scripts_to_test = [
@@ -231,6 +250,7 @@ def main():
     if datasets:
         print("\n⚡ Optimizer Execution:")
         tests.append(test_optimizer_execution(datasets))
+        tests.append(test_self_checks())
     
     # Python scripts test
     print("\n🐍 Python Scripts:")
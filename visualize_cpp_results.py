@@ -4,6 +4,27 @@ import matplotlib.pyplot as plt
 import json
 import os
 
+try:
+    import center_optimizer_py  # Built from center_optimizer_py.cpp
+except ImportError:
+    center_optimizer_py = None
+
+# Run the optimizer in-process through the Python extension
+def run_module(resource_df, zone_df, road_file):
+    points = resource_df.merge(zone_df, on='id', how='left')
+    optimizer = center_optimizer_py.KMedoidsOptimizer(3, 2, ['wetland'], 25)
+    optimizer.set_points(points['id'].to_numpy(), points['latitude'].to_numpy(), points['longitude'].to_numpy(),
+                         points['resource_quantity'].to_numpy(), points['land_type'].fillna('').tolist(),
+                         points['slope'].fillna(0).to_numpy(), points['elevation'].fillna(0).to_numpy())
+    # CSV rows are "from" points in km; the optimizer wants meters with one row per target point
+    roads = pd.read_csv(road_file, index_col=0).to_numpy(dtype=float) * 1000.0
+    optimizer.set_distances(roads.T.copy())
+    center_ids, total_cost = optimizer.optimize()
+    centers = [{'id': int(row['id']), 'lat': row['latitude'], 'lon': row['longitude'], 'land_type': row['land_type'],
+                'slope': row['slope'], 'elevation': row['elevation']}
+               for _, row in points[points['id'].isin(center_ids)].iterrows()]
+    return centers, total_cost
+
 # Run the C++ optimizer and parse output
 def run_cpp():
     # Try new data structure first, fallback to old
@@ -61,7 +82,11 @@ def main():
     else:
         resource_df = pd.read_csv('resource_points (1).csv')
         zone_df = pd.read_csv('zone_features.csv')
-    centers, total_cost = run_cpp()
+    if center_optimizer_py is not None:
+        road_file = 'data/road_network.csv' if os.path.exists('data/road_network.csv') else 'road_network.csv'
+        centers, total_cost = run_module(resource_df, zone_df, road_file)
+    else:
+        centers, total_cost = run_cpp()
     if not centers:
         print('No centers found.')
         return